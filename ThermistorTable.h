@@ -23,28 +23,30 @@
 // beta: 4066
 // max adc: 1023
 #define NUMTEMPS 20
-// {ADC, temp*4 }, // temp
-uint16_t temptable[NUMTABLES][NUMTEMPS][2] PROGMEM = {
+// slope is how much temp*4 falls per ADC count from the previous entry, times 256.
+// Trimming entries changes the slope of the entry after, use --adcs= to get them.
+// {ADC, temp*4, slope }, // temp
+uint16_t temptable[NUMTABLES][NUMTEMPS][3] PROGMEM = {
 {
-   {1, 3364}, // 841.027617469 C
-   {21, 1329}, // 332.486789769 C
-   {41, 1104}, // 276.102666373 C
-   {61, 987}, // 246.756060004 C
-   {81, 909}, // 227.268080588 C
-   {101, 851}, // 212.78847342 C
-   {121, 805}, // 201.30176775 C
-   {141, 767}, // 191.787692666 C
-   {161, 734}, // 183.662212795 C
-   {181, 706}, // 176.561442671 C
-   {201, 680}, // 170.244089549 C
-   {221, 658}, // 164.542298163 C
-   {241, 637}, // 159.33475843 C
-   {321, 567}, // 141.921298995 C
-   {381, 524}, // 131.166509425 C
-   {581, 406}, // 101.561865389 C
-   {781, 291}, // 72.9710018071 C
-   {881, 219}, // 54.8051659223 C
-   {981, 93}, // 23.4825243529 C
-   {1010, 1} // 0.498606463441 C
+   {1, 3364, 0}, // 841.027617469 C
+   {21, 1329, 26048}, // 332.486789769 C
+   {41, 1104, 2880}, // 276.102666373 C
+   {61, 987, 1498}, // 246.756060004 C
+   {81, 909, 998}, // 227.268080588 C
+   {101, 851, 742}, // 212.78847342 C
+   {121, 805, 589}, // 201.30176775 C
+   {141, 767, 486}, // 191.787692666 C
+   {161, 734, 422}, // 183.662212795 C
+   {181, 706, 358}, // 176.561442671 C
+   {201, 680, 333}, // 170.244089549 C
+   {221, 658, 282}, // 164.542298163 C
+   {241, 637, 269}, // 159.33475843 C
+   {321, 567, 224}, // 141.921298995 C
+   {381, 524, 183}, // 131.166509425 C
+   {581, 406, 151}, // 101.561865389 C
+   {781, 291, 147}, // 72.9710018071 C
+   {881, 219, 184}, // 54.8051659223 C
+   {981, 93, 323}, // 23.4825243529 C
+   {1010, 1, 812} // 0.498606463441 C
 }
 };
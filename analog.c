@@ -2,9 +2,20 @@
 
 /** \file
 	\brief Analog subsystem
+
+	The ADC interrupt converts all channels in use in turn. With
+	ADC_OVERSAMPLE, ADC_OVERSAMPLE conversions of each channel are summed up
+	and decimated to a reading with ADC_EXTRA_BITS more bits. ADC_FILTER
+	additionally runs the readings through a first order low pass.
+
+	Without ADC_TIMER_TRIGGER, each conversion starts the next one right
+	away, giving an interrupt every 104us. With it, the system clock tick
+	(timer 1 compare match B) starts a burst converting each channel once,
+	then the ADC idles until the next tick.
 */
 
 #include "temp.h"
+#include	"profile.h"
 
 #include	<avr/interrupt.h>
 
@@ -24,9 +35,26 @@
 #undef DEFINE_TEMP_SENSOR
 
 #ifdef AIO8_PIN
-static volatile uint16_t adc_result[ 16] __attribute__ ((__section__ (".bss")));
+	#define	ADC_CHANNELS	16
+#else
+	#define	ADC_CHANNELS	8
+#endif
+
+/// readings, 10 + ADC_EXTRA_BITS bits, times 2^ADC_FILTER with ADC_FILTER
+static volatile uint16_t adc_result[ADC_CHANNELS] __attribute__ ((__section__ (".bss")));
+
+#ifdef	ADC_TIMER_TRIGGER
+	/// auto trigger source timer 1 compare match B
+	#define	ADC_TRIGGER		(MASK(ADTS2) | MASK(ADTS0))
 #else
-static volatile uint16_t adc_result[ 8] __attribute__ ((__section__ (".bss")));
+	#define	ADC_TRIGGER		0
+#endif
+
+#if ADC_OVERSAMPLE > 1
+/// conversions summed up so far
+static uint16_t adc_sum[ADC_CHANNELS] __attribute__ ((__section__ (".bss")));
+/// number of the current round through all channels
+static uint8_t adc_round;
 #endif
 
 //! Configure all registers, start interrupt loop
@@ -45,7 +73,10 @@ void analog_init() {
 		// ADC frequency must be less than 200khz or we lose precision. At 16MHz system clock, we must use the full prescale value of 128 to get an ADC clock of 125khz.
 		ADCSRA = MASK(ADEN) | MASK(ADPS2) | MASK(ADPS1) | MASK(ADPS0);
 		#ifdef	ADCSRB
-			ADCSRB = 0;
+			ADCSRB = ADC_TRIGGER;
+		#endif
+		#ifdef	ADC_TIMER_TRIGGER
+			ADCSRA |= MASK(ADATE);
 		#endif
 
 		// clear analog inputs in the data direction register(s)
@@ -65,21 +96,58 @@ void analog_init() {
 	} /* analog_mask > 0 */
 }
 
+/*! store a reading
+	\param channel Channel the reading is for
+	\param r the reading, 10 + ADC_EXTRA_BITS bits
+*/
+static inline void adc_store(uint8_t channel, uint16_t r) {
+	#if ADC_FILTER
+		// Low pass, each reading moves the result by 1/2^ADC_FILTER of the
+		// difference. The result is kept scaled up by 2^ADC_FILTER for
+		// precision, the first reading seeds it.
+		if (adc_result[channel] == 0)
+			adc_result[channel] = r << ADC_FILTER;
+		else
+			adc_result[channel] += r - (adc_result[channel] >> ADC_FILTER);
+	#else
+		adc_result[channel] = r;
+	#endif
+}
+
 /*! Analog Interrupt
 
 	This is where we read our analog value and store it in an array for later retrieval
 */
 ISR(ADC_vect, ISR_NOBLOCK) {
+	PROFILE_START(ADC);
 
 	static uint8_t 	adc_counter = 0;
+#ifdef	ADC_TIMER_TRIGGER
+	uint8_t	round_done = 0;
+#endif
 #ifdef	AIO8_PIN
 	int16_t adc_channel_mask = (1 << adc_counter);
 #else
 	int8_t	adc_channel_mask = (1 << adc_counter);
 #endif
 
-	// Store the latest result in the array
-	adc_result[ adc_counter] = ADC;
+	uint16_t r = ADC;
+
+#if ADC_OVERSAMPLE > 1
+	// Sum up conversions, until we have ADC_OVERSAMPLE of them. The sum has
+	// twice the ADC_EXTRA_BITS, shifting half of them out leaves the ones
+	// gained from averaging the noise.
+	r += adc_sum[adc_counter];
+	if (adc_round == ADC_OVERSAMPLE - 1) {
+		adc_sum[adc_counter] = 0;
+		adc_store(adc_counter, r >> ADC_EXTRA_BITS);
+	}
+	else {
+		adc_sum[adc_counter] = r;
+	}
+#else
+	adc_store(adc_counter, r);
+#endif
 
 	// Determine the next active channel for selection, use the sign of the
 	// register to detect the last channel.
@@ -88,6 +156,12 @@ ISR(ADC_vect, ISR_NOBLOCK) {
 			// wrap around from msb to lsb
 			adc_channel_mask = 1;
 			adc_counter = 0;
+			#ifdef	ADC_TIMER_TRIGGER
+				round_done = 1;
+			#endif
+			#if ADC_OVERSAMPLE > 1
+				adc_round = (adc_round + 1) & (ADC_OVERSAMPLE - 1);
+			#endif
 		} else {
 			adc_channel_mask <<= 1;
 			adc_counter	+= 1;
@@ -99,18 +173,24 @@ ISR(ADC_vect, ISR_NOBLOCK) {
 	// register can be cleared.
 	ADMUX = (adc_counter & 0x07) | REFERENCE;
 	#ifdef	MUX5
-		ADCSRB = adc_counter & 0x08;
+		ADCSRB = (adc_counter & 0x08) | ADC_TRIGGER;
+	#endif
+
+	// After the mux has been set, start a new conversion, unless the timer
+	// starts the next round
+	#ifdef	ADC_TIMER_TRIGGER
+	if ( ! round_done)
 	#endif
+		ADCSRA |= MASK(ADSC);
 
-	// After the mux has been set, start a new conversion 
-	ADCSRA |= MASK(ADSC);
+	PROFILE_END(ADC);
 }
 
-/*! Read analog value from saved result array
+/*! Read analog value from saved result array, with all the resolution we have
 	\param channel Channel to be read
-	\return analog reading, 10-bit right aligned
+	\return analog reading, 10 + ADC_EXTRA_BITS bit right aligned
 */
-uint16_t	analog_read(uint8_t channel) {
+uint16_t	analog_read_fine(uint8_t channel) {
 	if (analog_mask > 0) {
 		uint16_t r;
 
@@ -126,8 +206,16 @@ uint16_t	analog_read(uint8_t channel) {
 		// restore interrupt flag
 		SREG = sreg;
 
-		return r;
+		return r >> ADC_FILTER;
 	} else {
 		return 0;
 	}
 }
+
+/*! Read analog value from saved result array
+	\param channel Channel to be read
+	\return analog reading, 10-bit right aligned
+*/
+uint16_t	analog_read(uint8_t channel) {
+	return analog_read_fine(channel) >> ADC_EXTRA_BITS;
+}
@@ -25,8 +25,35 @@
 #error REFERENCE undefined
 #endif
 
+#ifndef	ADC_OVERSAMPLE
+	#define	ADC_OVERSAMPLE	1
+#endif
+
+/// bits of resolution added by ADC_OVERSAMPLE, half a bit per doubling
+#if ADC_OVERSAMPLE == 1
+	#define	ADC_EXTRA_BITS	0
+#elif ADC_OVERSAMPLE == 4
+	#define	ADC_EXTRA_BITS	1
+#elif ADC_OVERSAMPLE == 16
+	#define	ADC_EXTRA_BITS	2
+#elif ADC_OVERSAMPLE == 64
+	#define	ADC_EXTRA_BITS	3
+#else
+	#error ADC_OVERSAMPLE must be 1, 4, 16 or 64
+#endif
+
+#ifdef	ADC_FILTER
+	#if ADC_FILTER + ADC_EXTRA_BITS > 6
+		#error ADC_FILTER too large, readings would overflow 16 bits
+	#endif
+#else
+	#define	ADC_FILTER			0
+#endif
+
 void 			analog_init(void);
 
 uint16_t	analog_read(uint8_t channel);
 
+uint16_t	analog_read_fine(uint8_t channel);
+
 #endif	/* _ANALOG_H */
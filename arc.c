@@ -0,0 +1,268 @@
+#include	"arc.h"
+
+/** \file
+	\brief G2/G3 arcs - split arcs into linear moves
+
+	Instead of having the host send lots of tiny G1 moves, an arc is received
+	as a single command and split into moves of about ARC_SEGMENT_LENGTH here.
+	Only one move is generated at a time, whenever the movebuffer has room,
+	so an arc of any length needs no extra memory.
+
+	Geometry is done in micrometers relative to the centre of the arc. Angles
+	are binary angles, 2^32 being a full turn, so they wrap around for free.
+	Sine and cosine come from CORDIC, which needs nothing but shifts and adds.
+	Each segment endpoint is calculated from the start of the arc, so errors
+	don't accumulate along the arc.
+*/
+
+#include	<avr/pgmspace.h>
+
+#include	"dda_queue.h"
+#include	"dda_util.h"
+#include	"gcode_parse.h"
+#include	"gcode_process.h"
+
+#ifdef ARC_SUPPORT
+
+/// length of a segment [um]
+#define	ARC_SEGMENT_UM		((uint32_t) (ARC_SEGMENT_LENGTH * 1000.0))
+/// upper limit for the number of segments, keeps calculations within 32 bits
+#define	ARC_MAX_SEGMENTS	4096
+/// number of CORDIC iterations, one bit of precision each
+#define	CORDIC_STEPS			20
+
+/// arctan(2^-i) as binary angle
+static const int32_t PROGMEM cordic_atan[CORDIC_STEPS] = {
+	536870912, 316933406, 167458907, 85004756, 42667331, 21354465, 10679838,
+	5340245, 2670163, 1335087, 667544, 333772, 166886, 83443, 41722, 20861,
+	10430, 5215, 2608, 1304
+};
+
+/// state of the arc being split into moves
+static struct {
+	TARGET		start;		///< where the arc starts [steps]
+	TARGET		end;			///< where the arc ends [steps]
+	int32_t		I;				///< X distance from start to centre [um]
+	int32_t		J;				///< Y distance from start to centre [um]
+	uint32_t	angle;		///< angle covered by one segment
+	uint16_t	segments;	///< number of segments, 0 if there's no arc to do
+	uint16_t	segment;	///< number of segments queued so far
+	uint8_t		clockwise;	///< G2 instead of G3
+} arc;
+
+/*! convert a distance in steps to micrometers
+	\param steps distance [steps], up to 2^21
+	\param spm steps per meter of this axis
+*/
+static int32_t steps_to_um(int32_t steps, uint32_t spm) {
+	uint32_t s = (steps < 0) ? -steps : steps;
+	uint32_t um;
+
+	s *= 1000;
+	um = (s / spm) * 1000 + ((s % spm) * 1000) / spm;
+	return (steps < 0) ? -(int32_t)um : (int32_t)um;
+}
+
+/*! convert a distance in micrometers to steps
+	\param um distance [um], up to 2^20
+	\param spm steps per meter of this axis
+*/
+static int32_t um_to_steps(int32_t um, uint32_t spm) {
+	uint32_t u = (um < 0) ? -um : um;
+	uint32_t steps;
+
+	steps = ((u / 1000) * spm + ((u % 1000) * spm) / 1000 + 500) / 1000;
+	return (um < 0) ? -(int32_t)steps : (int32_t)steps;
+}
+
+/*! rotate a vector
+	\param *x X component [um], up to 2^19, rotated in place
+	\param *y Y component [um], up to 2^19, rotated in place
+	\param angle binary angle to rotate by, counter-clockwise
+*/
+static void cordic_rotate(int32_t *x, int32_t *y, uint32_t angle) {
+	int32_t xi, yi, xt, a, z = angle;
+	uint8_t i;
+
+	// Scale up by 64 for precision and down by the CORDIC gain of 1.64676 in one go.
+	xi = *x * 38 + ((*x * 1770) >> 11);
+	yi = *y * 38 + ((*y * 1770) >> 11);
+
+	// CORDIC converges for angles up to +-99 degrees, so flip larger ones
+	if (z > 0x40000000 || z < -0x40000000) {
+		xi = -xi;
+		yi = -yi;
+		z += 0x80000000;
+	}
+
+	for (i = 0; i < CORDIC_STEPS; i++) {
+		a = pgm_read_dword(&cordic_atan[i]);
+		if (z >= 0) {
+			xt = xi - (yi >> i);
+			yi += xi >> i;
+			z -= a;
+		}
+		else {
+			xt = xi + (yi >> i);
+			yi -= xi >> i;
+			z += a;
+		}
+		xi = xt;
+	}
+
+	*x = (xi + 32) >> 6;
+	*y = (yi + 32) >> 6;
+}
+
+/*! angle of a vector
+	\param x X component [um], up to 2^19
+	\param y Y component [um], up to 2^19
+	\return binary angle, counter-clockwise from the X axis
+*/
+static uint32_t cordic_atan2(int32_t x, int32_t y) {
+	int32_t xt, z = 0;
+	uint8_t i;
+
+	x <<= 6;
+	y <<= 6;
+	if (x < 0) {
+		x = -x;
+		y = -y;
+		z = 0x80000000;
+	}
+
+	for (i = 0; i < CORDIC_STEPS; i++) {
+		if (y > 0) {
+			xt = x + (y >> i);
+			y -= x >> i;
+			z += pgm_read_dword(&cordic_atan[i]);
+		}
+		else {
+			xt = x - (y >> i);
+			y += x >> i;
+			z -= pgm_read_dword(&cordic_atan[i]);
+		}
+		x = xt;
+	}
+
+	return z;
+}
+
+/*! set up an arc
+	\param *target where the arc ends
+	\param I X distance from startpoint to the centre [um]
+	\param J Y distance from startpoint to the centre [um]
+	\param clockwise G2 if true, G3 otherwise
+
+	Moves are queued by subsequent calls to arc_step(), as long as arc_busy() says so.
+	A target equal to startpoint in X and Y gives a full circle.
+*/
+void arc_start(TARGET *target, int32_t I, int32_t J, uint8_t clockwise) {
+	int32_t x, y;
+	uint32_t sweep, turns, length;
+
+	arc.start = startpoint;
+	arc.end = *target;
+	arc.I = I;
+	arc.J = J;
+	arc.clockwise = clockwise;
+	arc.segment = 0;
+
+	// angle from start to end, around the centre
+	x = steps_to_um(target->X - startpoint.X, STEPS_PER_M_X) - I;
+	y = steps_to_um(target->Y - startpoint.Y, STEPS_PER_M_Y) - J;
+	sweep = cordic_atan2(x, y) - cordic_atan2(-I, -J);
+	if (clockwise)
+		sweep = -sweep;
+	turns = sweep >> 20;
+	if (target->X == startpoint.X && target->Y == startpoint.Y) {
+		sweep = 0xFFFFFFFF;
+		turns = 4096;
+	}
+
+	// 2 pi r, 2 pi being 201 / 32
+	length = approx_distance_2d((I < 0) ? -I : I, (J < 0) ? -J : J);
+	length = (((length * turns) >> 12) * 201) >> 5;
+
+	length = (length + ARC_SEGMENT_UM / 2) / ARC_SEGMENT_UM;
+	if (length == 0)
+		length = 1;
+	if (length > ARC_MAX_SEGMENTS)
+		length = ARC_MAX_SEGMENTS;
+	arc.segments = length;
+	arc.angle = sweep / length;
+}
+
+/*! set up an arc given by its radius
+	\param *target where the arc ends
+	\param R radius [um], negative to select the arc of more than 180 degrees
+	\param clockwise G2 if true, G3 otherwise
+*/
+void arc_start_radius(TARGET *target, int32_t R, uint8_t clockwise) {
+	int32_t x, y, h, d;
+	uint8_t s = 0;
+
+	x = steps_to_um(target->X - startpoint.X, STEPS_PER_M_X);
+	y = steps_to_um(target->Y - startpoint.Y, STEPS_PER_M_Y);
+	h = (R < 0) ? -R : R;
+
+	// scale down far enough for the squares to fit into 32 bits
+	while ((h >> s) >= 0x4000)
+		s++;
+	x >>= s;
+	y >>= s;
+	h >>= s;
+
+	// chord length and distance of the centre from the chord, both doubled
+	d = x * x + y * y;
+	h = 4 * h * h;
+	h = (h > d) ? int_sqrt(h - d) : 0;
+	d = int_sqrt(d);
+	if (d == 0) {
+		// start and end are the same, there's no way to tell where the centre is
+		arc.segments = 0;
+		enqueue(target);
+		return;
+	}
+
+	// for counter-clockwise arcs up to 180 degrees the centre is left of the chord
+	if (clockwise != (R < 0))
+		h = -h;
+	arc_start(target, ((x - (y * h) / d) / 2) << s, ((y + (x * h) / d) / 2) << s, clockwise);
+}
+
+/// queue the next segment of the current arc
+void arc_step() {
+	TARGET t = arc.end;
+	int32_t x, y;
+	uint16_t k, n = arc.segments;
+
+	k = ++arc.segment;
+	if (k < n) {
+		x = -arc.I;
+		y = -arc.J;
+		cordic_rotate(&x, &y, arc.clockwise ? -(arc.angle * k) : arc.angle * k);
+		t.X = arc.start.X + um_to_steps(arc.I + x, STEPS_PER_M_X);
+		t.Y = arc.start.Y + um_to_steps(arc.J + y, STEPS_PER_M_Y);
+		t.Z = arc.start.Z + delta_part(arc.end.Z - arc.start.Z, k, n);
+	}
+	#ifdef E_ABSOLUTE
+		t.E = arc.start.E + delta_part(arc.end.E - arc.start.E, k, n);
+	#else
+		// E is relative to the previous segment
+		t.E = delta_part(arc.end.E, k, n) - delta_part(arc.end.E, k - 1, n);
+	#endif
+
+	if (k >= n)
+		arc.segments = 0;
+	// the end is within the axis limits already, the way there may not be
+	clip_to_axis_limits(&t);
+	enqueue(&t);
+}
+
+/// are there segments of the current arc left to queue?
+uint8_t arc_busy() {
+	return arc.segments ? 255 : 0;
+}
+
+#endif	/* ARC_SUPPORT */
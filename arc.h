@@ -0,0 +1,25 @@
+#ifndef	_ARC_H
+#define	_ARC_H
+
+#include	<stdint.h>
+
+#include	"config.h"
+#include	"dda.h"
+
+#ifdef ARC_SUPPORT
+
+// set up an arc from startpoint to *target, centre given relative to startpoint [um]
+void arc_start(TARGET *target, int32_t I, int32_t J, uint8_t clockwise);
+
+// set up an arc from its radius [um], negative for arcs of more than 180 degrees
+void arc_start_radius(TARGET *target, int32_t R, uint8_t clockwise);
+
+// queue the next segment of the current arc
+void arc_step(void);
+
+// are there segments of the current arc left to queue?
+uint8_t arc_busy(void);
+
+#endif	/* ARC_SUPPORT */
+
+#endif	/* _ARC_H */
@@ -27,10 +27,29 @@
 
 /// Read a pin
 #define		_READ(IO)					(IO ## _RPORT & MASK(IO ## _PIN))
+#ifndef	SIMULATOR
 /// write to a pin
 #define		_WRITE(IO, v)			do { if (v) { IO ## _WPORT |= MASK(IO ## _PIN); } else { IO ## _WPORT &= ~MASK(IO ## _PIN); }; } while (0)
 /// toggle a pin
 #define		_TOGGLE(IO)				do { IO ## _RPORT = MASK(IO ## _PIN); } while (0)
+/// toggle the pins in mask on the port of a pin with one write, writing PINx leaves the others alone
+#define		_TOGGLE_PORT(IO, m)	do { IO ## _RPORT = (m); } while (0)
+#else
+#include	"simulator.h"
+/// write to a pin, the simulator watches for step pulses
+#define		_WRITE(IO, v)			do { if (v) { IO ## _WPORT |= MASK(IO ## _PIN); } else { IO ## _WPORT &= ~MASK(IO ## _PIN); }; sim_pins_written(); } while (0)
+/// toggle a pin, simulated registers don't know about writing to PINx
+#define		_TOGGLE(IO)				do { IO ## _WPORT ^= MASK(IO ## _PIN); sim_pins_written(); } while (0)
+/// toggle the pins in mask on the port of a pin
+#define		_TOGGLE_PORT(IO, m)	do { IO ## _WPORT ^= (m); sim_pins_written(); } while (0)
+#endif
+
+/// output levels of all pins on the port of a pin
+#define		_PORT_LEVELS(IO)	(IO ## _WPORT)
+/// whether two pins are on the same port, a constant
+#define		_SAME_PORT(IO1, IO2)	(&IO1 ## _WPORT == &IO2 ## _WPORT)
+/// bit of a pin in its port
+#define		_PIN_BIT(IO)			MASK(IO ## _PIN)
 
 /// set pin as input
 #define		_SET_INPUT(IO)		do { IO ## _DDR &= ~MASK(IO ## _PIN); } while (0)
@@ -50,6 +69,14 @@
 #define		WRITE(IO, v)			_WRITE(IO, v)
 /// toggle a pin wrapper
 #define		TOGGLE(IO)				_TOGGLE(IO)
+/// toggle pins on a port wrapper
+#define		TOGGLE_PORT(IO, m)	_TOGGLE_PORT(IO, m)
+/// port levels wrapper
+#define		PORT_LEVELS(IO)		_PORT_LEVELS(IO)
+/// same port wrapper
+#define		SAME_PORT(IO1, IO2)	_SAME_PORT(IO1, IO2)
+/// pin bit wrapper
+#define		PIN_BIT(IO)				_PIN_BIT(IO)
 
 /// set pin as input wrapper
 #define		SET_INPUT(IO)			_SET_INPUT(IO)
@@ -45,7 +45,7 @@ void clock_250ms() {
 			sersendf_P(PSTR("Pos: %ld,%ld,%ld,%ld,%lu\n"), current_position.X, current_position.Y, current_position.Z, current_position.E, current_position.F);
 
 			// target position
-			sersendf_P(PSTR("Dst: %ld,%ld,%ld,%ld,%lu\n"), movebuffer[mb_tail].endpoint.X, movebuffer[mb_tail].endpoint.Y, movebuffer[mb_tail].endpoint.Z, movebuffer[mb_tail].endpoint.E, movebuffer[mb_tail].endpoint.F);
+			sersendf_P(PSTR("Dst: %ld,%ld,%ld,%ld,%lu\n"), move_state.endpoint.X, move_state.endpoint.Y, move_state.endpoint.Z, move_state.endpoint.E, movebuffer[mb_tail].F);
 
 			// Queue
 			print_queue();
@@ -390,7 +390,7 @@ DEFINE_TEMP_SENSOR(bed,			TT_INTERCOM,	1,		0)
 
 /**
 	move buffer size, in number of moves
-		note that each move takes a fair chunk of ram (69 bytes as of this writing) so don't make the buffer too big - a bigger serial readbuffer may help more than increasing this unless your gcodes are more than 70 characters long on average.
+		has to be a power of 2. Note that each move takes a fair chunk of ram (74 bytes with LOOKAHEAD, 40 without, as of this writing) so don't make the buffer too big - a bigger serial readbuffer may help more than increasing this unless your gcodes are more than 70 characters long on average.
 		however, a larger movebuffer will probably help with lots of short consecutive moves, as each move takes a bunch of math (hence time) to set up so a longer buffer allows more of the math to be done during preceding longer moves
 */
 #define	MOVEBUFFER_SIZE	8
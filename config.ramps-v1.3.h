@@ -162,6 +162,54 @@
 /// decimal allowed, useful range 1. to 10'000, typical range 10. to 100.
 #define ACCELERATION 400.
 
+/** \def ACCELERATION_X
+	maximum acceleration of each axis, in mm/s^2. The acceleration of a move
+	is reduced until no axis gets more of it than allowed here, useful for
+	slow Z axes or heavy beds. Axes not listed can take the full ACCELERATION.
+*/
+// #define ACCELERATION_X 400.
+// #define ACCELERATION_Y 400.
+// #define ACCELERATION_Z 100.
+// #define ACCELERATION_E 400.
+
+/** \def RAMP_TABLE
+	look up step times while ramping, requires ACCELERATION_RAMPING and NEW_DDA_CALCULATIONS.
+		Instead of a 32 bit division in the step interrupt, the step time of each ramp step is the initial step time of the movement multiplied by a factor from a table in flash. This allows higher step rates while accelerating, at the cost of 512 bytes of flash and a speed error below 1% on long ramps.
+		The gain on the AVR is an estimate from the instruction sequences, not a measurement: about 100 clock ticks per ramp step for the lookup against some 600 for the division. The simulator can't show it, as a PC divides in hardware, simulator/ramp_moves.py gives the moves to compare with. M251 with STEP_PROFILE on a board does show it.
+*/
+// #define RAMP_TABLE
+
+/** \def LOOKAHEAD
+	look-ahead planner, requires ACCELERATION_RAMPING and NEW_DDA_CALCULATIONS.
+		Instead of coming to a full stop at the end of each movement, consecutive movements are joined at a speed depending on the angle between them. The planner runs whenever a movement is queued and looks at all movements waiting in the movebuffer, so a larger MOVEBUFFER_SIZE allows higher speeds on short segments.
+*/
+// #define LOOKAHEAD
+
+/// how far the path may deviate from the exact corner when joining two movements, given in mm
+/// larger values give faster junctions, typical range 0.01 to 0.1
+#define LOOKAHEAD_JUNCTION_DEVIATION 0.05
+
+/** \def MULTISTEP_THRESHOLD
+	multiple steps per step interrupt, requires ACCELERATION_RAMPING.
+		When steps are due faster than this, 2, 4 or 8 steps are done per interrupt and the time to the next interrupt is multiplied accordingly. This saves interrupt overhead at high step rates, so the step rate isn't limited by the interrupt rate. Steps then come in short bursts, though.
+		Given in CPU clock ticks between two interrupts, 400 ticks at 16 MHz is 40'000 interrupts per second.
+		Each step after the first one of an interrupt busy waits 2us for the drivers to see the pulse, with interrupts still disabled. So 8 steps per interrupt hold off serial reception and the clock for 14us. M251 with STEP_PROFILE shows this in the dstp line.
+*/
+// #define MULTISTEP_THRESHOLD 400
+
+/** \def STEP_RING_SIZE
+	step interrupts worked out ahead, requires ACCELERATION_RAMPING, can't be used together with MULTISTEP_THRESHOLD.
+		If defined, the main loop does the Bresenham iterations and speed calculations for up to this many step interrupts ahead. The step interrupt then only sets the step pins and the timer, so it is much shorter and step timing is more even. When the main loop falls behind, the step interrupt does the work itself as without this option.
+		Has to be a power of 2, each entry takes 5 bytes of RAM.
+*/
+// #define STEP_RING_SIZE 32
+
+/** \def STEP_RING_BATCH
+	most step interrupts worked out in one pass of the main loop, defaults to STEP_RING_SIZE.
+		Smaller values keep the main loop responsive while a long ring is refilled, larger values refill it faster.
+*/
+// #define STEP_RING_BATCH 8
+
 /** \def ACCELERATION_TEMPORAL
 	temporal step algorithm
 		This algorithm causes the timer to fire when any axis needs to step, instead of synchronising to the axis with the most steps ala bresenham.
@@ -262,6 +310,16 @@ DEFINE_TEMP_SENSOR( extruder,	TT_THERMISTOR,	(AIO13_PIN + 8),	THERMISTOR_EXTRUDE
 */
 // #define	HEATER_SANITY_CHECK
 
+/** \def PID_AUTOTUNE
+	M139 measures how a heater responds with a relay test and works out PID factors from that, see gcode_process.c. Costs about 1 kB of flash, not available with BANG_BANG.
+*/
+// #define	PID_AUTOTUNE
+
+/** \def HEATER_FEEDFORWARD
+	Add heater power for the current rate of extrusion and for the target temperature on top of PID, set per heater with M137 and M138. Both factors are 0 until set, not available with BANG_BANG.
+*/
+// #define	HEATER_FEEDFORWARD
+
 /***************************************************************************\
 *                                                                           *
 * Define your heaters here                                                  *
@@ -326,6 +384,18 @@ DEFINE_HEATER( extruder,	PB4)
 */
 #define	BAUD	115200
 
+/** \def RX_BUFSIZE
+	Size of the serial receive buffer [bytes], a power of 2, 256 at most.
+		Commands are read a whole line at a time. While the movebuffer is full, the host can send the next lines ahead into this buffer. 256 holds some 6 to 8 lines of typical G-code, 64 (the default) one or two. Each byte is taken from RAM.
+*/
+// #define	RX_BUFSIZE	256
+
+/** \def OK_CREDITS
+	Report free buffer space with each "ok".
+		Adds "Q:<moves> R:<bytes>" right after each "ok ", ahead of the output of the command, the number of moves which fit into the movebuffer and the number of bytes which fit into the receive buffer. Both are counted before the command is executed, so Q still includes room for the move of the line being acknowledged. A host can send the next lines ahead as long as they fit into R, less the lines sent since the line being acknowledged, instead of waiting for each ok. sender.sh and mendel_print in func.sh do so. Hosts expecting a bare ok may choke on this.
+*/
+// #define	OK_CREDITS
+
 /** \def XONXOFF
 	Xon/Xoff flow control.
 		Redundant when using RepRap Host for sending GCode, but mandatory when sending GCode files with a plain terminal emulator, like GtkTerm (Linux), CoolTerm (Mac) or HyperTerminal (Windows).
@@ -333,6 +403,12 @@ DEFINE_HEATER( extruder,	PB4)
 */
 #define	XONXOFF
 
+/** \def BINARY_GCODE
+	Binary transport for moves.
+		After M252, moves can be sent as binary frames, already scaled to steps by the host, instead of G-code. This takes a third to half the bytes per move and no parsing, allowing for more short moves per second. Needs a host which can do this, like gcode2bin.py. See gcode_binary.c for details.
+*/
+// #define	BINARY_GCODE
+
 
 
 /***************************************************************************\
@@ -368,11 +444,26 @@ PWM value for 'off'
 
 /**
 	move buffer size, in number of moves
-		note that each move takes a fair chunk of ram (69 bytes as of this writing) so don't make the buffer too big - a bigger serial readbuffer may help more than increasing this unless your gcodes are more than 70 characters long on average.
+		has to be a power of 2, the build stops with an error otherwise. Note that each move takes a fair chunk of ram (74 bytes with LOOKAHEAD, 28 without, as of this writing) so don't make the buffer too big - a bigger serial readbuffer may help more than increasing this unless your gcodes are more than 70 characters long on average.
 		however, a larger movebuffer will probably help with lots of short consecutive moves, as each move takes a bunch of math (hence time) to set up so a longer buffer allows more of the math to be done during preceding longer moves
 */
 #define	MOVEBUFFER_SIZE	8
 
+/** \def ARC_SUPPORT
+	G2/G3 arcs in the XY plane.
+		Arcs are split into short linear movements by the firmware, one at a time as room in the movebuffer frees up. This saves the host from sending hundreds of tiny G1 movements for each circle, which easily saturates the serial line.
+*/
+// #define	ARC_SUPPORT
+
+/// length of the linear movements an arc is split into, given in mm
+#define	ARC_SEGMENT_LENGTH	0.5
+
+/** \def STEP_PROFILE
+	measure the run time of the step interrupt.
+		Run times of the step interrupt and of the functions it calls are measured in CPU clock ticks and collected as minimum, maximum, mean and a histogram. M251 reports them. Costs some 20 clock ticks per measurement and about 120 bytes of RAM, so leave it off for production use.
+*/
+// #define STEP_PROFILE
+
 /** \def USE_WATCHDOG
 	Teacup implements a watchdog, which has to be reset every 250ms or it will reboot the controller. As rebooting (and letting the GCode sending application trying to continue the build with a then different Home point) is probably even worse than just hanging, and there is no better restore code in place, this is disabled for now.
 */
@@ -384,6 +475,24 @@ PWM value for 'off'
 */
 #define	REFERENCE			REFERENCE_AVCC
 
+/** \def ADC_OVERSAMPLE
+	Number of conversions summed up for each analog reading, 1, 4, 16 or 64.
+		Each factor of 4 averages out noise and adds one bit of resolution, which temperature lookups make use of. A conversion takes 104us, so with 16 and two sensors a new reading comes every 3.3ms, about three per temperature tick. Costs 2 bytes of RAM per analog channel.
+*/
+// #define	ADC_OVERSAMPLE	16
+
+/** \def ADC_FILTER
+	Smooth analog readings with a first order low pass filter.
+		Each new reading moves the result by 1/2^ADC_FILTER of the difference, so the result settles after some 2^ADC_FILTER readings. Together with ADC_OVERSAMPLE at most 6 - ADC_EXTRA_BITS, leave it undefined for no filtering.
+*/
+// #define	ADC_FILTER		2
+
+/** \def ADC_TIMER_TRIGGER
+	Start analog conversions from the system clock instead of back to back.
+		Every 2ms clock tick converts each analog channel once, then the ADC waits for the next tick. This cuts analog interrupts from some 9600 per second to 500 per second and channel, leaving more CPU time for stepping. With ADC_OVERSAMPLE, a new reading comes every ADC_OVERSAMPLE * 2ms. M251 with STEP_PROFILE shows the interrupt count.
+*/
+// #define	ADC_TIMER_TRIGGER
+
 /** \def STEP_INTERRUPT_INTERRUPTIBLE
 	this option makes the step interrupt interruptible (nested).
 	this should help immensely with dropped serial characters, but may also make debugging infuriating due to the complexities arising from nested interrupts
@@ -391,6 +500,12 @@ PWM value for 'off'
 */
 #define		STEP_INTERRUPT_INTERRUPTIBLE	1
 
+/** \def STEP_PULSE_WIDTH
+	length of step pulses in microseconds, ATmega1280/2560 only.
+		If defined, step pulses are ended by timer 1 comparator C this long after they started, instead of at the end of the step interrupt. This gives pulses of the same length regardless of the calculations done in between and lets the step interrupt return earlier. Steps must not come faster than twice this time.
+*/
+// #define	STEP_PULSE_WIDTH	2
+
 /**
 	temperature history count. This is how many temperature readings to keep in order to calculate derivative in PID loop
 	higher values make PID derivative term more stable at the expense of reaction time
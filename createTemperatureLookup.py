@@ -28,9 +28,12 @@ Options:
   --r2=... 			R2 rating where # is the ohm rating of R2 (eg: 10K = 10000)
   --num-temps=... 	the number of temperature points to calculate (default: 20)
   --max-adc=... 	the max ADC reading to use.  if you use R1, it limits the top value for the thermistor circuit, and thus the possible range of ADC values
+  --adcs=...		comma separated, rising list of ADC readings to put into the table instead of evenly spaced ones (eg: 1,21,41,321,1010)
 
 It is suggested to generate more values than you need, and delete some of the ones in the ranges
 that aren't interesting. This will improve accuracy in the temperature ranges that are important to you.
+As each entry carries the slope from the entry before, give the readings you kept with --adcs= and
+use the new table instead of deleting lines by hand.
 """
 
 from math import *
@@ -75,9 +78,10 @@ def main(argv):
 	r2 = 1600;
 	num_temps = int(20);
 	max_adc = int(1023);
+	adcs = None
 	
 	try:
-		opts, args = getopt.getopt(argv, "h", ["help", "r0=", "t0=", "beta=", "r1=", "r2=", "max-adc=", "num-temps="])
+		opts, args = getopt.getopt(argv, "h", ["help", "r0=", "t0=", "beta=", "r1=", "r2=", "max-adc=", "num-temps=", "adcs="])
 	except getopt.GetoptError:
 		usage()
 		sys.exit(2)
@@ -100,13 +104,15 @@ def main(argv):
 			max_adc = int(arg)
 		elif opt == "--num-temps":
 			num_temps = int(arg)
+		elif opt == "--adcs":
+			adcs = [int(a) for a in arg.split(",")]
 			
 	increment = int(max_adc/(num_temps-1));
 	
 	t = Thermistor(r0, t0, beta, r1, r2)
 
-	adcs = range(1, max_adc, increment);
-#	adcs = [1, 20, 25, 30, 35, 40, 45, 50, 60, 70, 80, 90, 100, 110, 130, 150, 190, 220,  250, 300]
+	if adcs is None:
+		adcs = range(1, max_adc, increment);
 	first = 1
 
 	#Chop of negative temperatures (as we're using a unsigned 16-bit value for temp)
@@ -129,7 +135,7 @@ def main(argv):
 	print "// Since you'll have to do some testing to determine the correct temperature for your application anyway, you"
 	print "// may decide that the effort isn't worth it. Who cares if it's reporting the \"right\" temperature as long as it's"
 	print "// keeping the temperature steady enough to print, right?"
-	print "// ./createTemperatureLookup.py --r0=%s --t0=%s --r1=%s --r2=%s --beta=%s --max-adc=%s" % (r0, t0, r1, r2, beta, max_adc)
+	print "// ./createTemperatureLookup.py --r0=%s --t0=%s --r1=%s --r2=%s --beta=%s --max-adc=%s --adcs=%s" % (r0, t0, r1, r2, beta, max_adc, ",".join(str(a) for a in adcs))
 	print "// r0: %s" % (r0)
 	print "// t0: %s" % (t0)
 	print "// r1: %s" % (r1)
@@ -137,16 +143,30 @@ def main(argv):
 	print "// beta: %s" % (beta)
 	print "// max adc: %s" % (max_adc)
 	print "#define NUMTEMPS %s" % (len(adcs))
-	print "// {ADC, temp*4 }, // temp"
-	print "uint16_t temptable[NUMTEMPS][2] PROGMEM = {"
+	print "// slope is how much temp*4 falls per ADC count from the previous entry, times 256."
+	print "// Trimming entries changes the slope of the entry after, use --adcs= to get them."
+	print "// {ADC, temp*4, slope }, // temp"
+	print "uint16_t temptable[NUMTEMPS][3] PROGMEM = {"
 
 	counter = 0
 	for adc in adcs:
+		temp = int(t.temp(adc)*4)
+		# the firmware interpolates from the upper end of a segment, with the
+		# slope in 8.8 fixed point, see temp_sensor_tick()
+		if counter == 0:
+			slope = 0
+		else:
+			slope = int(round(256.0 * (last_temp - temp) / (adc - last_adc)))
+			if adc <= last_adc or slope < 0 or slope > 65535:
+				sys.stderr.write("ADC %s: slope %s doesn't fit, readings have to rise and temperatures to fall by less than 256 per ADC count\n" % (adc, slope))
+				sys.exit(2)
+		last_adc = adc
+		last_temp = temp
 		counter = counter +1
 		if counter == len(adcs):
-			print "   {%s, %s} // %s C" % (adc, int(t.temp(adc)*4), t.temp(adc))
+			print "   {%s, %s, %s} // %s C" % (adc, temp, slope, t.temp(adc))
 		else:
-			print "   {%s, %s}, // %s C" % (adc, int(t.temp(adc)*4), t.temp(adc))
+			print "   {%s, %s, %s}, // %s C" % (adc, temp, slope, t.temp(adc))
 	print "};"
 	
 def usage():
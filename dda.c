@@ -22,6 +22,12 @@
 	#include	"heater.h"
 #endif
 #include	"dda_util.h"
+#include	"delay.h"
+#include	"profile.h"
+#include	"memory_barrier.h"
+#ifdef	LOOKAHEAD
+	#include	"dda_lookahead.h"
+#endif
 
 /// step timeout
 volatile uint8_t	steptimeout = 0;
@@ -43,6 +49,164 @@ TARGET current_position __attribute__ ((__section__ (".bss")));
 /// \brief numbers for tracking the current state of movement
 MOVE_STATE move_state __attribute__ ((__section__ (".bss")));
 
+#ifdef MULTISTEP_THRESHOLD
+	/// steps done per interrupt, as power of 2
+	#define	MULTISTEP	move_state.multistep
+#else
+	#define	MULTISTEP	0
+#endif
+
+#ifdef LOOKAHEAD
+	/// ramp step, step time of the first step and slowest step time of a move
+	#define	DDA_START_STEPS(dda)	((dda)->start_steps)
+	#define	DDA_START_C(dda)			((dda)->start_c)
+	#define	DDA_END_C(dda)				((dda)->end_c)
+#else
+	// without look-ahead, moves start and end at standstill, saving the fields
+	#define	DDA_START_STEPS(dda)	0
+	#define	DDA_START_C(dda)			((dda)->c0)
+	#define	DDA_END_C(dda)				((dda)->c0)
+#endif
+
+#ifdef STEP_RING_SIZE
+/*
+	step ring
+
+	Without STEP_RING_SIZE, each step interrupt does its Bresenham iteration
+	and works out the time to the next step, a division on most steps. With
+	it, dda_fill_ring() does this work ahead from the main loop, one event
+	per step interrupt, and the interrupt just starts the pulses and sets the
+	timer. Should the main loop fall behind and the ring run empty, the step
+	interrupt does the work itself, as without a ring. If the main loop is
+	in the middle of an event just then, the interrupt comes back a moment
+	later.
+
+	Single producer, single consumer: dda_fill_ring() writes step_ring_head,
+	dda_step() writes step_ring_tail. The ring holds events of the move at
+	mb_tail only, dda_start() empties it. The event after the last step is
+	marked STEP_LAST, it ends the move.
+
+	As move_state runs ahead of the steps actually done, positions reported
+	during a move are ahead by up to STEP_RING_SIZE steps.
+*/
+
+#if STEP_RING_SIZE & (STEP_RING_SIZE - 1)
+	#error STEP_RING_SIZE has to be a power of 2.
+#endif
+
+#ifndef STEP_RING_BATCH
+	#define	STEP_RING_BATCH	STEP_RING_SIZE
+#endif
+
+/// event flag: the move ends with this event
+#define	STEP_LAST				0x80
+
+/// time until the step interrupt looks again when dda_fill_ring() is busy [CPU clock ticks]
+#define	STEP_RING_RETRY	(F_CPU / 100000)
+
+/// one step interrupt, worked out ahead
+typedef struct {
+	uint8_t						axes;			///< axes to step, AXIS_* bits, or STEP_LAST
+	uint32_t					interval;	///< time to the next step interrupt [CPU clock ticks]
+} STEP_EVENT;
+
+/// events worked out ahead
+static STEP_EVENT step_ring[STEP_RING_SIZE];
+
+/// next event to write, only written by dda_fill_ring() and dda_start()
+static volatile uint8_t step_ring_head;
+
+/// next event to execute, only written by dda_step() and dda_start()
+static volatile uint8_t step_ring_tail;
+
+/// dda_fill_ring() is working on an event
+static volatile uint8_t step_ring_busy;
+
+/// the STEP_LAST event is in the ring, nothing more to do for this move
+static volatile uint8_t step_ring_done;
+#endif
+
+#ifdef RAMP_TABLE
+#include	<avr/pgmspace.h>
+
+/// \var ramp_table
+/// \brief step time at ramp step i relative to c0, \f$\sqrt{2} (\sqrt{i + 1} - \sqrt{i})\f$, 32768 = 1.0
+static const uint16_t PROGMEM ramp_table[256] = {
+	46341, 19195, 14729, 12417, 10940, 9890, 9095, 8465, 7951, 7520, 7153, 6834,
+	6555, 6307, 6086, 5886, 5705, 5539, 5388, 5248, 5118, 4997, 4885, 4780,
+	4681, 4589, 4501, 4419, 4340, 4266, 4196, 4129, 4064, 4003, 3945, 3889,
+	3835, 3784, 3734, 3687, 3641, 3597, 3554, 3513, 3473, 3435, 3398, 3362,
+	3327, 3293, 3261, 3229, 3198, 3168, 3139, 3110, 3083, 3056, 3029, 3004,
+	2979, 2955, 2931, 2908, 2885, 2863, 2841, 2820, 2800, 2779, 2760, 2740,
+	2721, 2703, 2684, 2667, 2649, 2632, 2615, 2599, 2582, 2567, 2551, 2536,
+	2521, 2506, 2491, 2477, 2463, 2449, 2436, 2422, 2409, 2396, 2384, 2371,
+	2359, 2347, 2335, 2323, 2311, 2300, 2289, 2278, 2267, 2256, 2245, 2235,
+	2224, 2214, 2204, 2194, 2185, 2175, 2165, 2156, 2147, 2138, 2129, 2120,
+	2111, 2102, 2093, 2085, 2077, 2068, 2060, 2052, 2044, 2036, 2028, 2021,
+	2013, 2005, 1998, 1991, 1983, 1976, 1969, 1962, 1955, 1948, 1941, 1934,
+	1928, 1921, 1914, 1908, 1901, 1895, 1889, 1882, 1876, 1870, 1864, 1858,
+	1852, 1846, 1840, 1835, 1829, 1823, 1818, 1812, 1807, 1801, 1796, 1790,
+	1785, 1780, 1774, 1769, 1764, 1759, 1754, 1749, 1744, 1739, 1734, 1729,
+	1725, 1720, 1715, 1710, 1706, 1701, 1697, 1692, 1688, 1683, 1679, 1674,
+	1670, 1666, 1661, 1657, 1653, 1649, 1645, 1640, 1636, 1632, 1628, 1624,
+	1620, 1616, 1612, 1609, 1605, 1601, 1597, 1593, 1589, 1586, 1582, 1578,
+	1575, 1571, 1568, 1564, 1560, 1557, 1553, 1550, 1546, 1543, 1540, 1536,
+	1533, 1529, 1526, 1523, 1520, 1516, 1513, 1510, 1507, 1503, 1500, 1497,
+	1494, 1491, 1488, 1485, 1482, 1479, 1476, 1473, 1470, 1467, 1464, 1461,
+	1458, 1455, 1452, 1450
+};
+
+/*! step time at a given position of the ramp
+	\param c0 step time at the start of the ramp, 24.8 fixed point
+	\param n ramp tracking variable as used by dda_step()
+	\return step time, 24.8 fixed point
+
+	Beyond the end of the table, the step time is proportional to \f$1 / \sqrt{i}\f$, so dividing the ramp step by 4 and the result by 2 gives the same value.
+*/
+static inline uint32_t ramp_c(uint32_t c0, int32_t n) __attribute__ ((always_inline));
+static inline uint32_t ramp_c(uint32_t c0, int32_t n) {
+	uint32_t i = (n > 0) ? (n >> 2) : ((-n - 1) >> 2);
+	uint16_t factor;
+	uint8_t shift = 0;
+
+	while (i >= 256) {
+		i = (i + 2) >> 2;
+		shift++;
+	}
+	factor = pgm_read_word(&ramp_table[i]);
+
+	// c0 * factor / 32768, done as two 16 x 16 bit multiplications
+	return ((((c0 >> 16) * factor) << 1) + (((c0 & 0xFFFF) * factor) >> 15)) >> shift;
+}
+#endif
+
+#ifdef ACCELERATION_RAMPING
+/*! limit the acceleration of a move to what one axis can take
+	\param accel acceleration of the move [mm/s^2]
+	\param axis_accel maximum acceleration of this axis [mm/s^2]
+	\param um distance this axis moves [um]
+	\param distance length of the move [um]
+	\return acceleration of the move, such that this axis' share doesn't exceed axis_accel
+*/
+static uint32_t axis_accel_limit(uint32_t accel, uint32_t axis_accel, uint32_t um, uint32_t distance) {
+	uint32_t u;
+
+	// distance is an approximation, so um can be slightly more
+	if (um > distance)
+		um = distance;
+	// keep (um << 12) within 32 bits for moves longer than 1 m
+	if (distance >> 20) {
+		um >>= 8;
+		distance >>= 8;
+	}
+	// share of this axis in the move, 4096 = 1.0
+	u = (um << 12) / distance;
+	if (u && (axis_accel << 12) < accel * u)
+		accel = (axis_accel << 12) / u;
+	return accel;
+}
+#endif
+
 /*! Inititalise DDA movement structures
 */
 void dda_init(void) {
@@ -89,8 +253,7 @@ void dda_create(DDA *dda, TARGET *target) {
 	if (DEBUG_DDA && (debug_flags & DEBUG_DDA)) {
 		serial_writestr_P(PSTR("\n{DDA_CREATE: ["));
 	}
-	// we end at the passed target
-	memcpy(&(dda->endpoint), target, sizeof(TARGET));
+	dda->F = target->F;
 
 	dda->x_delta = labs(target->X - startpoint.X);
 	dda->y_delta = labs(target->Y - startpoint.Y);
@@ -103,7 +266,7 @@ void dda_create(DDA *dda, TARGET *target) {
 	dda->e_direction = (target->E >= startpoint.E)?1:0;
 
 	if (DEBUG_DDA && (debug_flags & DEBUG_DDA))
-		sersendf_P(PSTR("%c%ld,%c%ld,%c%ld,%c%ld] ["),
+		sersendf_P(PSTR("%c%u,%c%u,%c%u,%c%u] ["),
 			(dda->x_direction)? '+' : '-', dda->x_delta,
 			(dda->y_direction)? '+' : '-', dda->y_delta,
 			(dda->z_direction)? '+' : '-', dda->z_delta,
@@ -119,7 +282,24 @@ void dda_create(DDA *dda, TARGET *target) {
 		dda->total_steps = dda->e_delta;
 
 	if (DEBUG_DDA && (debug_flags & DEBUG_DDA))
-		sersendf_P(PSTR("ts:%lu"), dda->total_steps);
+		sersendf_P(PSTR("ts:%u"), dda->total_steps);
+
+	// pick the step routine, see dda_step_moving()
+	dda->axes = 0;
+	if (dda->x_delta)
+		dda->axes |= AXIS_X;
+	if (dda->y_delta)
+		dda->axes |= AXIS_Y;
+	if (dda->z_delta)
+		dda->axes |= AXIS_Z;
+	if (dda->e_delta)
+		dda->axes |= AXIS_E;
+	if ((dda->axes & ~AXES_XY) == 0)
+		dda->axes = AXES_XY;
+	else if (dda->axes != AXES_E && (dda->axes & ~AXES_XYE) == 0)
+		dda->axes = AXES_XYE;
+	else if (dda->axes != AXES_Z && dda->axes != AXES_E)
+		dda->axes = AXES_XYZE;
 
 	if (dda->total_steps == 0) {
 		dda->nullmove = 1;
@@ -159,6 +339,25 @@ void dda_create(DDA *dda, TARGET *target) {
 			sersendf_P(PSTR(",ef:%lu,ds:%lu"), e_feed, distance);
 		}
 
+		#ifdef ACCELERATION_RAMPING
+			// The move accelerates along its direction. Each axis gets its share of
+			// that acceleration, so the axis least capable of it limits the move.
+			uint32_t accel = ACCELERATION;
+			if (ACCELERATION_X < ACCELERATION)
+				accel = axis_accel_limit(accel, ACCELERATION_X, STEPS_TO_UM( X, dda->x_delta), distance);
+			if (ACCELERATION_Y < ACCELERATION)
+				accel = axis_accel_limit(accel, ACCELERATION_Y, STEPS_TO_UM( Y, dda->y_delta), distance);
+			if (ACCELERATION_Z < ACCELERATION)
+				accel = axis_accel_limit(accel, ACCELERATION_Z, STEPS_TO_UM( Z, dda->z_delta), distance);
+			if (ACCELERATION_E < ACCELERATION)
+				accel = axis_accel_limit(accel, ACCELERATION_E, STEPS_TO_UM( E, dda->e_delta), distance);
+			if (accel == 0)
+				accel = 1;
+			if (DEBUG_DDA && (debug_flags & DEBUG_DDA)) {
+				sersendf_P(PSTR(",ac:%lu"), accel);
+			}
+		#endif
+
 		#ifdef	ACCELERATION_TEMPORAL
 			// bracket part of this equation in an attempt to avoid overflow: 60 * 16MHz * 5mm is >32 bits
 			uint32_t move_duration = distance * (60 * F_CPU / startpoint.F);
@@ -259,7 +458,7 @@ void dda_create(DDA *dda, TARGET *target) {
 		// is not sufficient as it's only valid for a single axis move along the x (and y by accident).
 		// We need to calculate c0 for each move, and that implies a division and a square root operation.
 
-		dda->c0 = (F_CPU / int_sqrt( (1000 * ACCELERATION * dda->total_steps) / distance)) << 8;
+		dda->c0 = (F_CPU / int_sqrt( (1000. * accel * dda->total_steps) / distance)) << 8;
 		if (DEBUG_DDA && (debug_flags & DEBUG_DDA)) {
 			sersendf_P(PSTR(",c0:%lu"), dda->c0 >> 8);
 		}
@@ -326,7 +525,6 @@ void dda_create(DDA *dda, TARGET *target) {
 #ifdef ACCELERATION_STEEPNESS
 #error ACCELERATION_STEEPNESS is gone, review your config.h and use ACCELERATION
 #endif
-			// yes, this assumes always the x axis as the critical one regarding acceleration. If we want to implement per-axis acceleration, things get tricky ...
 #ifndef NEW_DDA_CALCULATIONS
 			dda->c_min = (move_duration / target->F) << 8;
 			if (dda->c_min < c_limit << 8)
@@ -340,47 +538,25 @@ void dda_create(DDA *dda, TARGET *target) {
 			}
 			// 20110819 modmaker - Calculation of the length of the ramps.
 			// 
-			// The profile is always symetrical (i.e. ramp up and ramp down have
-			// the same slope, defined by ACCELERATION).
-			//
-			// This is a very tricky calculation to do in 32 bits as all precision is
-			// needed to get the correct number of steps. If bits are lost and the
-			// number is small, the reached feed will be too low.
-			// 
-			// Do this calculation in several steps so it's easy to detect overflow
-			// when debug is on.
-			uint32_t x = (F_CPU / c_limit);						// (24 - 11..12) -> 12..13 bits
-			if (DEBUG_DDA && (debug_flags & DEBUG_DDA)) {
-				sersendf_P(PSTR(",(x:%lu"), x);
-			}
-			x *= x;												// + (24 - 11..12) -> 24..26 bits
-			if (DEBUG_DDA && (debug_flags & DEBUG_DDA)) {
-				sersendf_P(PSTR("->%lu"), x);
-			}
-			x >>= 12;	/* scale down but keep precision! */	// - 12 -> 12..14 bits
+			// Both ramps have the same slope, defined by accel. Entry and
+			// exit speed may differ, the move starts and ends at standstill
+			// unless the look-ahead planner changes that later on.
+			uint32_t cruise_steps = dda_accel_steps(c_limit, distance, dda->total_steps, accel);
+			#ifdef LOOKAHEAD
+				dda->cruise_steps = cruise_steps;
+			#endif
+			dda_ramps(dda->total_steps, cruise_steps, 0, 0, &dda->rampup_steps, &dda->rampdown_steps);
 			if (DEBUG_DDA && (debug_flags & DEBUG_DDA)) {
-				sersendf_P(PSTR("->%lu"), x);
-			}
-			x *= distance;										// + 5..18 -> 17..32 bits
-			if (DEBUG_DDA && (debug_flags & DEBUG_DDA)) {
-				sersendf_P(PSTR("->%lu"), x);
-			}
-			// total_steps has a fixed relation to distance (um/step) !
-			x /= (((uint32_t)(2000 * ACCELERATION) >> 6) * dda->total_steps) >> 6; //    -> 0..14 bits
-			if (DEBUG_DDA && (debug_flags & DEBUG_DDA)) {
-				sersendf_P(PSTR("->%lu"), x);
-			}
-			dda->rampup_steps = x;
-			// If move is too short for full ramp-up and ramp-down, clip ramping.
-			if (2 * dda->rampup_steps > dda->total_steps) {
-				dda->rampup_steps = dda->total_steps / 2;
-			}
-			// rampdown_steps is not actually the number of rampdown steps, but the
-			// step number at which the rampdown starts!
-			dda->rampdown_steps = dda->total_steps - dda->rampup_steps;
-			if (DEBUG_DDA && (debug_flags & DEBUG_DDA)) {
-				sersendf_P(PSTR(",ru:%lu,rd:%lu"), dda->rampup_steps, dda->rampdown_steps);
+				sersendf_P(PSTR(",ru:%u,rd:%u"), dda->rampup_steps, dda->rampdown_steps);
 			}
+			#ifdef LOOKAHEAD
+				dda->start_steps = 0;
+				dda->start_c = dda->end_c = dda->c0;
+				dda->distance = distance;
+				dda->acceleration = accel;
+				dda->F_entry_max = dda->F_end = 0;
+				dda_find_crossing_speed(dda, target->F);
+			#endif
 		#else
 #ifndef NEW_DDA_CALCULATIONS
 			dda->c = (move_duration / target->F) << 8;
@@ -418,7 +594,7 @@ void dda_start(DDA *dda) {
 	// called from interrupt context: keep it simple!
 	if (dda->nullmove) {
 		// just change speed?
-		current_position.F = dda->endpoint.F;
+		current_position.F = dda->F;
 		// keep dda->live = 0
 	}
 	else {
@@ -440,14 +616,31 @@ void dda_start(DDA *dda) {
 
 		// initialise state variable
 		move_state.x_counter = move_state.y_counter = move_state.z_counter = \
-			move_state.e_counter = -(dda->total_steps >> 1);
-		memcpy(&move_state.x_steps, &dda->x_delta, sizeof(uint32_t) * 4);
+			move_state.e_counter = -(int32_t) (dda->total_steps >> 1);
+		move_state.x_steps = dda->x_delta;
+		move_state.y_steps = dda->y_delta;
+		move_state.z_steps = dda->z_delta;
+		move_state.e_steps = dda->e_delta;
 		#ifdef ACCELERATION_RAMPING
 			move_state.step_no = 0;
 		#endif
+		#ifdef STEP_RING_SIZE
+			step_ring_head = step_ring_tail = 0;
+			step_ring_done = 0;
+		#endif
+
+		// this move ends where the previous one ended plus its distances
+		move_state.endpoint.X += dda->x_direction ? (int32_t) dda->x_delta : -(int32_t) dda->x_delta;
+		move_state.endpoint.Y += dda->y_direction ? (int32_t) dda->y_delta : -(int32_t) dda->y_delta;
+		move_state.endpoint.Z += dda->z_direction ? (int32_t) dda->z_delta : -(int32_t) dda->z_delta;
+		#ifdef E_ABSOLUTE
+			move_state.endpoint.E += dda->e_direction ? (int32_t) dda->e_delta : -(int32_t) dda->e_delta;
+		#endif
 
 		# ifdef NEW_DDA_CALCULATIONS
-			move_state.c = dda->c0;
+			// a move joined to the previous one starts in the middle of the ramp
+			move_state.c = DDA_START_C(dda);
+			move_state.n = (DDA_START_STEPS(dda) << 2) + 1;
 		# endif
 
 		// ensure this dda starts
@@ -455,7 +648,7 @@ void dda_start(DDA *dda) {
 
 		// set timeout for first step
 		#ifdef ACCELERATION_RAMPING
-		if (dda->c_min > move_state.c) // can be true when look-ahead removed all deceleration steps
+		if (dda->c_min > move_state.c) // entry speed can be slightly above c_min due to rounding
 			setTimer(dda->c_min >> 8);
 		else
 			setTimer(move_state.c >> 8);
@@ -465,6 +658,205 @@ void dda_start(DDA *dda) {
 	}
 }
 
+/// one Bresenham iteration for axis a, left out at compile time unless AXIS_A is in axes
+#define	DDA_STEP_AXIS(a, A) \
+	if ((axes & AXIS_##A) && move_state.a##_steps) { \
+		move_state.a##_counter -= dda->a##_delta; \
+		if (move_state.a##_counter < 0) { \
+			did_step |= AXIS_##A; \
+			move_state.a##_steps--; \
+			move_state.a##_counter += dda->total_steps; \
+		} \
+	}
+
+/*! one Bresenham iteration for a set of axes
+	\param *dda the current move
+	\param axes the axes to look at, has to be a constant
+	\return the axes to step, AXIS_* bits
+*/
+static inline uint8_t dda_step_axes(DDA *dda, uint8_t axes) __attribute__ ((always_inline));
+static inline uint8_t dda_step_axes(DDA *dda, uint8_t axes) {
+	uint8_t	did_step = 0;
+
+	DDA_STEP_AXIS(x, X)
+	DDA_STEP_AXIS(y, Y)
+	DDA_STEP_AXIS(z, Z)
+	DDA_STEP_AXIS(e, E)
+
+	return did_step;
+}
+
+/*! one Bresenham iteration for the axes of this move
+	\param *dda the current move
+	\return the axes to step, AXIS_* bits
+
+	Each set of axes dda_create() picks gets its own copy of dda_step_axes(),
+	so the step interrupt doesn't look at axes which don't move at all. Each
+	axis left out saves a 32 bit test of its remaining steps, some 13 cycles
+	on the AVR, against some 4 to 6 for the switch. M251 with STEP_PROFILE
+	shows the time per step interrupt in the dstp line.
+*/
+static inline uint8_t dda_step_moving(DDA *dda) __attribute__ ((always_inline));
+static inline uint8_t dda_step_moving(DDA *dda) {
+	switch (dda->axes) {
+		case AXES_XYE:
+			return dda_step_axes(dda, AXES_XYE);
+		case AXES_XY:
+			return dda_step_axes(dda, AXES_XY);
+		case AXES_E:
+			return dda_step_axes(dda, AXES_E);
+		case AXES_Z:
+			return dda_step_axes(dda, AXES_Z);
+		default:
+			return dda_step_axes(dda, AXES_XYZE);
+	}
+}
+
+#ifdef ACCELERATION_RAMPING
+/*! speed for the next step
+	\param *dda the current move
+
+	Updates move_state.c, the time to the next step, for the step just done.
+*/
+static inline void dda_ramp(DDA *dda) __attribute__ ((always_inline));
+static inline void dda_ramp(DDA *dda) {
+	// - algorithm courtesy of http://www.embedded.com/columns/technicalinsights/56800129?printable=true
+	// - precalculate ramp lengths instead of counting them, see AVR446 tech note
+	uint8_t recalc_speed;
+
+	// debug ramping algorithm
+	//if (move_state.step_no == 0) {
+	//	sersendf_P(PSTR("\r\nc %lu  c_min %lu  n %d"), dda->c, dda->c_min, move_state.n);
+	//}
+
+	recalc_speed = 0;
+	if (move_state.step_no < dda->rampup_steps) {
+		if (move_state.n < 0) // wrong ramp direction
+			move_state.n = -((int32_t)2) - move_state.n;
+		recalc_speed = 1;
+	}
+	else if (move_state.step_no > dda->rampdown_steps) {
+		if (move_state.n > 0) // wrong ramp direction
+			move_state.n = -((int32_t)2) - move_state.n;
+		recalc_speed = 1;
+	}
+	if (recalc_speed) {
+		move_state.n += 4 << MULTISTEP;
+		#ifdef RAMP_TABLE
+			move_state.c = ramp_c(dda->c0, move_state.n);
+		#else
+			// be careful of signedness!
+			move_state.c = (int32_t)move_state.c - ((int32_t)((move_state.c * 2) << MULTISTEP) / (int32_t)move_state.n);
+		#endif
+		#ifdef NEW_DDA_CALCULATIONS
+		// don't get slower than the exit speed, the next move continues from there
+		if (move_state.n < 0 && move_state.c > DDA_END_C(dda))
+			move_state.c = DDA_END_C(dda);
+		#endif
+	}
+	move_state.step_no += 1 << MULTISTEP;
+
+	// debug ramping algorithm
+	// for very low speeds like 10 mm/min, only
+	//if (move_state.step_no % 10 /* 10, 100, ...*/ == 0)
+	//	sersendf_P(PSTR("\r\nc %lu  c_min %lu  n %d"), dda->c, dda->c_min, move_state.n);
+}
+#endif
+
+/// whether all steps of the current move are done
+#define	dda_steps_done()	(move_state.x_steps == 0 && move_state.y_steps == 0 && move_state.z_steps == 0 && move_state.e_steps == 0)
+
+/*! the move is done
+	\param *dda the current move
+*/
+static void dda_finish(DDA *dda) {
+	dda->live = 0;
+	// if E is relative reset it
+	#ifndef E_ABSOLUTE
+		current_position.E = 0;
+	#endif
+	// linear acceleration code doesn't alter F during a move, so we must update it here
+	// in theory, we *could* update F every step, but that would require a divide in interrupt context which should be avoided if at all possible
+	current_position.F = dda->F;
+	#ifdef	DC_EXTRUDER
+		heater_set(DC_EXTRUDER, 0);
+	#endif
+	// z stepper is only enabled while moving
+	z_disable();
+}
+
+#ifdef STEP_RING_SIZE
+/** work out step interrupts ahead
+
+	Called from the main loop and from loops waiting for the movebuffer.
+	Adds up to STEP_RING_BATCH events for the current move to the ring.
+*/
+void dda_fill_ring() {
+	DDA	*dda;
+	uint8_t	h, n, axes;
+
+	step_ring_busy = 1;
+	MEMORY_BARRIER();
+	dda = &movebuffer[mb_tail];
+
+	for (n = STEP_RING_BATCH; n; n--) {
+		h = (step_ring_head + 1) & (STEP_RING_SIZE - 1);
+		if (h == step_ring_tail || step_ring_done || dda->live == 0 || dda->waitfor_temp)
+			break;
+
+		axes = dda_step_moving(dda);
+		dda_ramp(dda);
+		if (axes == 0 && dda_steps_done()) {
+			axes = STEP_LAST;
+			step_ring_done = 1;
+		}
+		step_ring[step_ring_head].axes = axes;
+		step_ring[step_ring_head].interval = ((dda->c_min > move_state.c) ? dda->c_min : move_state.c) >> 8;
+
+		MEMORY_BARRIER();
+		step_ring_head = h;
+	}
+
+	MEMORY_BARRIER();
+	step_ring_busy = 0;
+}
+
+/*! execute the next event from the ring
+	\param *dda the current move
+*/
+static inline void dda_step_ring(DDA *dda) __attribute__ ((always_inline));
+static inline void dda_step_ring(DDA *dda) {
+	uint8_t	t = step_ring_tail;
+	uint8_t	axes = step_ring[t].axes;
+	uint32_t	interval = step_ring[t].interval;
+
+	MEMORY_BARRIER();
+	step_ring_tail = (t + 1) & (STEP_RING_SIZE - 1);
+
+	step_pins(axes);
+
+	#ifdef STEP_PULSE_WIDTH
+		unstep_later();
+	#endif
+
+	#if STEP_INTERRUPT_INTERRUPTIBLE
+		sei();
+	#endif
+
+	if (axes & AXES_XYZE)
+		steptimeout = 0;
+	else if (axes & STEP_LAST)
+		dda_finish(dda);
+
+	cli();
+	setTimer(interval);
+
+	#ifndef STEP_PULSE_WIDTH
+	unstep();
+	#endif
+}
+#endif /* STEP_RING_SIZE */
+
 /*! STEP
 	\param *dda the current move
 
@@ -473,55 +865,65 @@ void dda_start(DDA *dda) {
 	Then we re-enable global interrupts so serial data reception and other important things can occur while we do some math.
 	Next, we work out how long until our next step using the selected acceleration algorithm and set the timer.
 	Then we decide if this was the last step for this move, and if so mark this dda as dead so next timer interrupt we can start a new one.
-	Finally we de-assert any asserted step pins.
+	Finally we de-assert any asserted step pins, unless STEP_PULSE_WIDTH has a timer doing this.
 
 	\todo take into account the time that interrupt takes to run
 */
 void dda_step(DDA *dda) {
 	uint8_t	did_step = 0;
 
-	if ((move_state.x_steps) /* &&
-			(x_max() != dda->x_direction) && (x_min() == dda->x_direction) */) {
-		move_state.x_counter -= dda->x_delta;
-		if (move_state.x_counter < 0) {
-			x_step();
-			did_step = 1;
-			move_state.x_steps--;
-			move_state.x_counter += dda->total_steps;
-		}
-	}
+	PROFILE_START(DDA_STEP);
 
-	if ((move_state.y_steps) /* &&
-			(y_max() != dda->y_direction) && (y_min() == dda->y_direction) */) {
-		move_state.y_counter -= dda->y_delta;
-		if (move_state.y_counter < 0) {
-			y_step();
-			did_step = 1;
-			move_state.y_steps--;
-			move_state.y_counter += dda->total_steps;
+	#ifdef STEP_PULSE_WIDTH
+		// Comparator C ranks below the step interrupt, so after a long time with
+		// interrupts off, the last pulses may still be up. End them here, or
+		// step_pins() would toggle them low instead of starting new ones.
+		if (TIMSK1 & MASK(OCIE1C)) {
+			unstep();
+			TIMSK1 &= ~MASK(OCIE1C);
+			delay_us(1);
 		}
-	}
+	#endif
 
-	if ((move_state.z_steps) /* &&
-			(z_max() != dda->z_direction) && (z_min() == dda->z_direction) */) {
-		move_state.z_counter -= dda->z_delta;
-		if (move_state.z_counter < 0) {
-			z_step();
-			did_step = 1;
-			move_state.z_steps--;
-			move_state.z_counter += dda->total_steps;
+	#ifdef STEP_RING_SIZE
+		if (step_ring_tail != step_ring_head) {
+			dda_step_ring(dda);
+			PROFILE_END(DDA_STEP);
+			return;
 		}
-	}
+		if (step_ring_busy) {
+			// dda_fill_ring() fell behind and is in the middle of an event
+			setTimer(STEP_RING_RETRY);
+			PROFILE_END(DDA_STEP);
+			return;
+		}
+		// dda_fill_ring() fell behind, do its work here
+	#endif
 
-	if (move_state.e_steps) {
-		move_state.e_counter -= dda->e_delta;
-		if (move_state.e_counter < 0) {
-			e_step();
-			did_step = 1;
-			move_state.e_steps--;
-			move_state.e_counter += dda->total_steps;
+	#ifdef MULTISTEP_THRESHOLD
+		uint8_t i, axes;
+
+		for (i = 1 << MULTISTEP; ; ) {
+			axes = dda_step_moving(dda);
+			step_pins(axes);
+			did_step |= axes;
+			if (--i == 0)
+				break;
+			// end this pulse and keep the pins low for a moment before the next one,
+			// this busy waiting with interrupts off is the price for saving interrupts
+			delay_us(1);
+			unstep();
+			delay_us(1);
 		}
-	}
+	#else
+		did_step = dda_step_moving(dda);
+		step_pins(did_step);
+	#endif
+
+	#ifdef STEP_PULSE_WIDTH
+		// a timer ends the pulses, so we don't have to care about them any longer
+		unstep_later();
+	#endif
 
 	#if STEP_INTERRUPT_INTERRUPTIBLE
 		// since we have sent steps to all the motors that will be stepping and the rest of this function isn't so time critical,
@@ -559,37 +961,7 @@ void dda_step(DDA *dda) {
 		}
 	#endif
 	#ifdef ACCELERATION_RAMPING
-		// - algorithm courtesy of http://www.embedded.com/columns/technicalinsights/56800129?printable=true
-		// - precalculate ramp lengths instead of counting them, see AVR446 tech note
-		uint8_t recalc_speed;
-
-		// debug ramping algorithm
-		//if (move_state.step_no == 0) {
-		//	sersendf_P(PSTR("\r\nc %lu  c_min %lu  n %d"), dda->c, dda->c_min, move_state.n);
-		//}
-
-		recalc_speed = 0;
-		if (move_state.step_no < dda->rampup_steps) {
-			if (move_state.n < 0) // wrong ramp direction
-				move_state.n = -((int32_t)2) - move_state.n;
-			recalc_speed = 1;
-		}
-		else if (move_state.step_no > dda->rampdown_steps) {
-			if (move_state.n > 0) // wrong ramp direction
-				move_state.n = -((int32_t)2) - move_state.n;
-			recalc_speed = 1;
-		}
-		if (recalc_speed) {
-			move_state.n += 4;
-			// be careful of signedness!
-			move_state.c = (int32_t)move_state.c - ((int32_t)(move_state.c * 2) / (int32_t)move_state.n);
-		}
-		move_state.step_no++;
-
-		// debug ramping algorithm
-		// for very low speeds like 10 mm/min, only
-		//if (move_state.step_no % 10 /* 10, 100, ...*/ == 0)
-		//	sersendf_P(PSTR("\r\nc %lu  c_min %lu  n %d"), dda->c, dda->c_min, move_state.n);
+		dda_ramp(dda);
 	#endif
 
 	// TODO: did_step is obsolete ...
@@ -600,20 +972,8 @@ void dda_step(DDA *dda) {
 		// if we could do anything at all, we're still running
 		// otherwise, must have finished
 	}
-	else if (move_state.x_steps == 0 && move_state.y_steps == 0 && move_state.z_steps == 0 && move_state.e_steps == 0) {
-		dda->live = 0;
-		// if E is relative reset it
-		#ifndef E_ABSOLUTE
-			current_position.E = 0;
-		#endif
-		// linear acceleration code doesn't alter F during a move, so we must update it here
-		// in theory, we *could* update F every step, but that would require a divide in interrupt context which should be avoided if at all possible
-		current_position.F = dda->endpoint.F;
-		#ifdef	DC_EXTRUDER
-			heater_set(DC_EXTRUDER, 0);
-		#endif
-		// z stepper is only enabled while moving
-		z_disable();
+	else if (dda_steps_done()) {
+		dda_finish(dda);
 	}
 
 	cli();
@@ -622,18 +982,29 @@ void dda_step(DDA *dda) {
 		// we don't hit maximum speed exactly with acceleration calculation, so limit it here
 		// the nice thing about _not_ setting dda->c to dda->c_min is, the move stops at the exact same c as it started, so we have to calculate c only once for the time being
 		// TODO: set timer only if dda->c has changed
-		if (dda->c_min > move_state.c)
-			setTimer(dda->c_min >> 8);
-		else
-			setTimer(move_state.c >> 8);
+		uint32_t c = (dda->c_min > move_state.c) ? dda->c_min : move_state.c;
+
+		#ifdef MULTISTEP_THRESHOLD
+			// More steps per interrupt when they come too fast, fewer when they
+			// slow down again. The gap between both limits avoids toggling.
+			if (((c >> 8) << MULTISTEP) < MULTISTEP_THRESHOLD && MULTISTEP < 3)
+				MULTISTEP++;
+			else if (((c >> 8) << MULTISTEP) > 3 * MULTISTEP_THRESHOLD && MULTISTEP > 0)
+				MULTISTEP--;
+		#endif
+		setTimer((c >> 8) << MULTISTEP);
 	#else
 		setTimer(dda->c >> 8);
 	#endif
 
+	#ifndef STEP_PULSE_WIDTH
 	// turn off step outputs, hopefully they've been on long enough by now to register with the drivers
 	// if not, too bad. or insert a (very!) small delay here, or fire up a spare timer or something.
 	// we also hope that we don't step before the drivers register the low- limit maximum speed if you think this is a problem.
 	unstep();
+	#endif
+
+	PROFILE_END(DDA_STEP);
 }
 
 /// update global current_position struct
@@ -644,26 +1015,158 @@ void update_position() {
 		return;
 
 	if (dda->x_direction)
-		current_position.X = dda->endpoint.X - move_state.x_steps;
+		current_position.X = move_state.endpoint.X - move_state.x_steps;
 	else
-		current_position.X = dda->endpoint.X + move_state.x_steps;
+		current_position.X = move_state.endpoint.X + move_state.x_steps;
 
 	if (dda->y_direction)
-		current_position.Y = dda->endpoint.Y - move_state.y_steps;
+		current_position.Y = move_state.endpoint.Y - move_state.y_steps;
 	else
-		current_position.Y = dda->endpoint.Y + move_state.y_steps;
+		current_position.Y = move_state.endpoint.Y + move_state.y_steps;
 
 	if (dda->z_direction)
-		current_position.Z = dda->endpoint.Z - move_state.z_steps;
+		current_position.Z = move_state.endpoint.Z - move_state.z_steps;
 	else
-		current_position.Z = dda->endpoint.Z + move_state.z_steps;
+		current_position.Z = move_state.endpoint.Z + move_state.z_steps;
 
 	#ifndef E_ABSOLUTE
 		current_position.E = move_state.e_steps;
 	#else
 		if (dda->e_direction)
-			current_position.E = dda->endpoint.E - move_state.e_steps;
+			current_position.E = move_state.endpoint.E - move_state.e_steps;
 		else
-			current_position.E = dda->endpoint.E + move_state.e_steps;
+			current_position.E = move_state.endpoint.E + move_state.e_steps;
 	#endif
 }
+
+/*! E steps per second of the move being stepped
+	\return rate of forward extrusion, 0 if not extruding
+
+	The current step time is read, so acceleration and deceleration are
+	accounted for.
+*/
+uint32_t dda_e_rate() {
+	DDA *dda = &movebuffer[mb_tail];
+	uint32_t c;
+	uint8_t sreg;
+
+	if (dda->live == 0 || dda->waitfor_temp || dda->e_delta == 0 || dda->e_direction == 0)
+		return 0;
+
+	// atomic 32-bit copy, the step interrupt changes it
+	sreg = SREG;
+	cli();
+	#ifdef ACCELERATION_RAMPING
+		c = (dda->c_min > move_state.c) ? dda->c_min : move_state.c;
+	#else
+		c = dda->c;
+	#endif
+	SREG = sreg;
+
+	c >>= 8;
+	if (c == 0)
+		return 0;
+	// E steps are e_delta / total_steps of the steps done every c clocks
+	return ((F_CPU / c) * (((uint32_t) dda->e_delta << 8) / dda->total_steps)) >> 8;
+}
+
+/** positions were set without moving
+
+	Call after changing startpoint with the queue empty, like G92 and homing
+	do, so the next move is tracked from there.
+*/
+void dda_new_startpoint() {
+	move_state.endpoint = startpoint;
+}
+
+#ifdef ACCELERATION_RAMPING
+/*! number of steps needed to accelerate from standstill to a given speed
+	\param c step time at the target speed [IOclocks]
+	\param distance length of the move [um]
+	\param total_steps number of steps of the move on the fastest axis
+	\param accel acceleration of the move [mm/s^2]
+	\return \f$v^2 / 2a\f$, with \f$v\f$ and \f$a\f$ in steps of the fastest axis
+
+	This is a very tricky calculation to do in 32 bits as all precision is
+	needed to get the correct number of steps. If bits are lost and the
+	number is small, the reached feed will be too low.
+*/
+uint32_t dda_accel_steps(uint32_t c, uint32_t distance, uint32_t total_steps, uint32_t accel) {
+	uint32_t v, um;
+	uint8_t frac, shift;
+
+	v = F_CPU / c;													// [steps / s]
+	if (v > 0xFFFF)
+		v = 0xFFFF;
+	v *= v;
+	// micrometers per step as fixed point number with frac fractional bits
+	frac = (distance >> 20) ? 8 : 12;
+	um = (distance << frac) / total_steps;
+	// total_steps has a fixed relation to distance (um/step), so
+	// a = 1000 * accel / um [steps / s^2].
+	// Scale down v^2 just enough for the product to fit into 32 bits.
+	shift = msbloc(v) + msbloc(um) + 2;
+	shift = (shift > 32) ? shift - 32 : 0;
+	v = ((v >> shift) * um) / (2000 * accel);
+	return (shift > frac) ? v << (shift - frac) : v >> (frac - shift);
+}
+
+/*! calculate ramp lengths of a move
+	\param total_steps number of steps of the move on the fastest axis
+	\param cruise_steps number of steps needed to accelerate from standstill to full speed
+	\param start_steps ramp step at the start of the move, 0 is standstill
+	\param end_steps ramp step at the end of the move
+	\param *rampup_steps number of steps accelerating is stored here
+	\param *rampdown_steps step number at which deceleration starts is stored here
+
+	If the move is too short to reach full speed, the peak is placed where
+	the rampup from start_steps meets the rampdown to end_steps.
+*/
+void dda_ramps(uint32_t total_steps, uint32_t cruise_steps, uint32_t start_steps, uint32_t end_steps, uint16_t *rampup_steps, uint16_t *rampdown_steps) {
+	uint32_t peak = cruise_steps, up, down;
+
+	if (start_steps > peak)
+		start_steps = peak;
+	if (end_steps > peak)
+		end_steps = peak;
+	if ((peak - start_steps) + (peak - end_steps) > total_steps) {
+		peak = (total_steps + start_steps + end_steps) >> 1;
+		if (peak < start_steps)
+			peak = start_steps;
+		if (peak < end_steps)
+			peak = end_steps;
+	}
+	// accelerating all the way is as far as it gets
+	up = peak - start_steps;
+	*rampup_steps = (up < total_steps) ? up : total_steps;
+	down = peak - end_steps;
+	// rampdown_steps is not actually the number of rampdown steps, but the
+	// step number at which the rampdown starts!
+	*rampdown_steps = (down < total_steps) ? total_steps - down : 0;
+}
+
+#ifdef NEW_DDA_CALCULATIONS
+/*! step time for a given feedrate
+	\param F feedrate [mm/min], must not be zero
+	\param distance length of the move [um]
+	\param total_steps number of steps of the move on the fastest axis
+	\return time between two steps of the fastest axis [IOclocks], 24.8 fixed point
+*/
+uint32_t dda_c_for_F(uint32_t F, uint32_t distance, uint32_t total_steps) {
+	// IOclocks per step = um per step * 60 [s/min] * F_CPU / (1000 [um/mm] * F)
+	const uint32_t k = (60 * (F_CPU / 1000)) >> 6;
+	uint32_t um;
+	uint8_t frac;
+
+	// micrometers per step as fixed point number with frac fractional bits
+	frac = (distance >> 20) ? 8 : 12;
+	um = (distance << frac) / total_steps;
+	while (um > 0xFFFFFFFF / k) {
+		um >>= 1;
+		frac--;
+	}
+	// 14 = 6 bits of k + 8 bits of the 24.8 format
+	return ((um * k) / F) << (14 - frac);
+}
+#endif
+#endif
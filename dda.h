@@ -4,6 +4,7 @@
 #include	<stdint.h>
 
 #include	"config.h"
+#include	"pinio.h"
 
 // Used in distance calculation during DDA setup
 /// micrometers per step X
@@ -15,12 +16,65 @@
 /// micrometers per step E
 #define	UM_PER_STEP_E		1000L / ((uint32_t) STEPS_PER_MM_E)
 
+/// longest distance a DDA can move an axis [steps], enqueue() splits longer moves
+#define	MAX_DELTA				0xFFFF
+
+/// sets of axes dda_step() has its own routine for, each move gets the smallest one covering its axes
+#define	AXES_XY					(AXIS_X | AXIS_Y)
+#define	AXES_XYE				(AXIS_X | AXIS_Y | AXIS_E)
+#define	AXES_Z					AXIS_Z
+#define	AXES_E					AXIS_E
+#define	AXES_XYZE				(AXIS_X | AXIS_Y | AXIS_Z | AXIS_E)
+
 #ifdef ACCELERATION_REPRAP
 	#ifdef ACCELERATION_RAMPING
 		#error Cant use ACCELERATION_REPRAP and ACCELERATION_RAMPING together.
 	#endif
 #endif
 
+#ifdef LOOKAHEAD
+	#if ! defined ACCELERATION_RAMPING || ! defined NEW_DDA_CALCULATIONS
+		#error LOOKAHEAD requires ACCELERATION_RAMPING and NEW_DDA_CALCULATIONS.
+	#endif
+#endif
+
+#ifdef MULTISTEP_THRESHOLD
+	#ifndef ACCELERATION_RAMPING
+		#error MULTISTEP_THRESHOLD requires ACCELERATION_RAMPING.
+	#endif
+#endif
+
+#ifdef STEP_RING_SIZE
+	#ifndef ACCELERATION_RAMPING
+		#error STEP_RING_SIZE requires ACCELERATION_RAMPING.
+	#endif
+	#ifdef MULTISTEP_THRESHOLD
+		#error Cant use STEP_RING_SIZE and MULTISTEP_THRESHOLD together.
+	#endif
+#endif
+
+#ifdef RAMP_TABLE
+	#if ! defined ACCELERATION_RAMPING || ! defined NEW_DDA_CALCULATIONS
+		#error RAMP_TABLE requires ACCELERATION_RAMPING and NEW_DDA_CALCULATIONS.
+	#endif
+#endif
+
+#ifdef ACCELERATION_RAMPING
+	// axes without their own acceleration limit can take the full ACCELERATION
+	#ifndef ACCELERATION_X
+		#define	ACCELERATION_X	ACCELERATION
+	#endif
+	#ifndef ACCELERATION_Y
+		#define	ACCELERATION_Y	ACCELERATION
+	#endif
+	#ifndef ACCELERATION_Z
+		#define	ACCELERATION_Z	ACCELERATION
+	#endif
+	#ifndef ACCELERATION_E
+		#define	ACCELERATION_E	ACCELERATION
+	#endif
+#endif
+
 /*
 	types
 */
@@ -59,8 +113,16 @@ typedef struct {
 	/// time until next step
 	uint32_t					c;		// 24.8 fixed point format
 	/// tracking variable
-	int16_t						n;
+	int32_t						n;
+	#endif
+	#ifdef MULTISTEP_THRESHOLD
+	/// steps done per interrupt, as power of 2
+	uint8_t						multistep;
 	#endif
+
+	/// where the current move ends, F unused. Moves store only their
+	/// distances, so this is advanced by each move started.
+	TARGET						endpoint;
 } MOVE_STATE;
 
 /**
@@ -71,8 +133,8 @@ typedef struct {
 	This struct is filled in by dda_create(), called from enqueue(), called mostly from gcode_process() and from a few other places too (eg \file homing.c)
 */
 typedef struct {
-	/// this is where we should finish
-	TARGET						endpoint;
+	/// feedrate of this move [mm/min]
+	uint32_t					F;
 
 	union {
 		struct {
@@ -95,16 +157,21 @@ typedef struct {
 		uint8_t							allflags;	///< used for clearing all flags
 	};
 
-	// distances
-	uint32_t					x_delta; ///< number of steps on X axis
-	uint32_t					y_delta; ///< number of steps on Y axis
-	uint32_t					z_delta; ///< number of steps on Z axis
-	uint32_t					e_delta; ///< number of steps on E axis
+	/// axes stepped by dda_step(), one of the AXES_* sets
+	uint8_t						axes;
+
+	// distances, enqueue() splits moves longer than MAX_DELTA
+	uint16_t					x_delta; ///< number of steps on X axis
+	uint16_t					y_delta; ///< number of steps on Y axis
+	uint16_t					z_delta; ///< number of steps on Z axis
+	uint16_t					e_delta; ///< number of steps on E axis
 
 	/// total number of steps: set to \f$\max(\Delta x, \Delta y, \Delta z, \Delta e)\f$
-	uint32_t					total_steps;
+	uint16_t					total_steps;
 
+	#ifndef ACCELERATION_RAMPING
 	uint32_t					c; ///< time until next step, 24.8 fixed point
+	#endif
 
 	#ifdef ACCELERATION_REPRAP
 	uint32_t					end_c; ///< time between 2nd last step and last step
@@ -112,15 +179,44 @@ typedef struct {
 	#endif
 	#ifdef ACCELERATION_RAMPING
 	/// number of steps accelerating
-	uint32_t					rampup_steps;
+	uint16_t					rampup_steps;
 	/// number of last step before decelerating
-	uint32_t					rampdown_steps;
+	uint16_t					rampdown_steps;
 	/// 24.8 fixed point timer value, maximum speed
 	uint32_t					c_min;
 	# ifdef NEW_DDA_CALCULATIONS
 	/// 24.8 fixed point timer value, initial counter value
 	uint32_t					c0;
 	# endif
+	# ifdef LOOKAHEAD
+	// without look-ahead, moves start and end at standstill, so these are
+	// 0, c0 and c0, see DDA_START_STEPS() and friends in dda.c
+	/// ramp step the move starts at, 0 is standstill
+	uint32_t					start_steps;
+	/// 24.8 fixed point timer value of the first step
+	uint32_t					start_c;
+	/// 24.8 fixed point timer value, slowest step time while decelerating
+	uint32_t					end_c;
+	/// number of steps to accelerate from standstill to c_min
+	uint32_t					cruise_steps;
+	/// length of the move [um]
+	uint32_t					distance;
+	/// acceleration of the move, limited by the slowest axis [mm/s^2]
+	uint16_t					acceleration;
+	/// maximum feedrate at the junction with the previous move [mm/min]
+	uint16_t					crossF;
+	/// maximum entry feedrate still allowing to stop at the end of the queue [mm/min]
+	uint16_t					F_entry_max;
+	/// planned exit feedrate [mm/min]
+	uint16_t					F_end;
+	/// planned values, copied to the ones above by dda_lookahead() in one go
+	uint16_t					next_F_end;
+	uint32_t					next_start_steps;
+	uint32_t					next_start_c;
+	uint32_t					next_end_c;
+	uint16_t					next_rampup_steps;
+	uint16_t					next_rampdown_steps;
+	# endif
 	#endif
 } DDA;
 
@@ -138,6 +234,9 @@ extern TARGET startpoint;
 /// current_position holds the machine's current position. this is only updated when we step, or when G92 (set home) is received.
 extern TARGET current_position;
 
+/// state of the move being executed
+extern MOVE_STATE move_state;
+
 /*
 	methods
 */
@@ -154,7 +253,31 @@ void dda_start(DDA *dda)																						__attribute__ ((hot));
 // DDA takes one step (called from timer interrupt)
 void dda_step(DDA *dda)																							__attribute__ ((hot));
 
+#ifdef STEP_RING_SIZE
+// work out step interrupts ahead, see dda.c
+void dda_fill_ring(void);
+#endif
+
 // update current_position
 void update_position(void);
 
+// E steps per second of the move being stepped
+uint32_t dda_e_rate(void);
+
+// positions were set without moving, e.g. by G92 or homing
+void dda_new_startpoint(void);
+
+#ifdef ACCELERATION_RAMPING
+// number of steps needed to accelerate from standstill to a given step time
+uint32_t dda_accel_steps(uint32_t c, uint32_t distance, uint32_t total_steps, uint32_t accel);
+
+// ramp lengths for a move entering and leaving at given ramp steps
+void dda_ramps(uint32_t total_steps, uint32_t cruise_steps, uint32_t start_steps, uint32_t end_steps, uint16_t *rampup_steps, uint16_t *rampdown_steps);
+
+#ifdef NEW_DDA_CALCULATIONS
+// step time for a given feedrate, 24.8 fixed point
+uint32_t dda_c_for_F(uint32_t F, uint32_t distance, uint32_t total_steps);
+#endif
+#endif
+
 #endif	/* _DDA_H */
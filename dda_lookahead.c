@@ -0,0 +1,324 @@
+#include	"dda_lookahead.h"
+
+/** \file
+	\brief Look-ahead planner - join consecutive moves without stopping in between
+
+	When a move is created, dda_find_crossing_speed() works out how fast we can
+	go through the corner between it and the previous move. This uses the
+	"junction deviation" idea: the speed is chosen such that a circle arc
+	tangent to both moves, not farther than LOOKAHEAD_JUNCTION_DEVIATION away
+	from the corner, could be followed with the acceleration of the slower of
+	both moves as centripetal acceleration.
+
+	After each move is queued, dda_lookahead() walks the movebuffer backwards
+	to find the highest entry speed each move can have while still being able
+	to stop at the end of the queue. Then it walks forwards again, finding the
+	actual entry and exit speeds and translating them into ramp lengths.
+
+	Speeds are handled as feedrates [mm/min], because two moves meeting at a
+	junction share the same feedrate, while their step rates differ.
+*/
+
+#include	<avr/interrupt.h>
+
+#include	"dda_queue.h"
+#include	"dda_util.h"
+#include	"memory_barrier.h"
+
+#ifdef LOOKAHEAD
+
+/// change of the squared feedrate when accelerating over 1 um at 1 mm/s^2, times 5
+#define	F2_PER_UM_5		36
+/// junction deviation, in feedrate units, times 1 mm/s^2 [mm^2/min^2]
+#define	JUNCTION_F2		((uint32_t) (3600 * LOOKAHEAD_JUNCTION_DEVIATION))
+
+#define	MB_NEXT(i)	(((i) + 1) & (MOVEBUFFER_SIZE - 1))
+#define	MB_PREV(i)	(((i) - 1) & (MOVEBUFFER_SIZE - 1))
+
+/// direction of the last created move as a unit vector, 4096 = 1.0
+static int16_t	last_dir[3];
+/// feedrate of the last created move [mm/min], zero if it ends at standstill
+static uint16_t	last_F;
+/// acceleration of the last created move [mm/s^2]
+static uint16_t	last_accel;
+
+/*! component of a unit vector
+	\param um distance along one axis [um]
+	\param distance length of the move [um]
+	\return um / distance, 4096 = 1.0
+*/
+static uint16_t unit(uint32_t um, uint32_t distance) {
+	uint32_t u = (um << 12) / distance;
+
+	// distance is an approximation, so this can be slightly more than 1.0
+	return (u > 4096) ? 4096 : u;
+}
+
+/*! limit a feedrate to the maximum feedrate of one axis
+	\param F feedrate of the move [mm/min]
+	\param u component of the unit vector of this axis, 4096 = 1.0
+	\param max maximum feedrate of this axis [mm/min]
+*/
+static uint16_t axis_limit(uint16_t F, uint16_t u, uint32_t max) {
+	if (u && ((uint32_t) F * u) > (max << 12))
+		F = (max << 12) / u;
+	return F;
+}
+
+/*! find the maximum feedrate at the junction with the previous move
+	\param *dda the move just created, with distance already set
+	\param F the requested feedrate of this move [mm/min]
+
+	Sets dda->crossF. Called from dda_create() for all moves which aren't nullmoves.
+*/
+void dda_find_crossing_speed(DDA *dda, uint32_t F) {
+	uint32_t x, y, z, e, distance, F2, junction_f2;
+	uint16_t sine, crossF;
+	int16_t dir[3];
+	int32_t dot;
+
+	x = STEPS_TO_UM(X, dda->x_delta);
+	y = STEPS_TO_UM(Y, dda->y_delta);
+	z = STEPS_TO_UM(Z, dda->z_delta);
+	e = STEPS_TO_UM(E, dda->e_delta);
+	distance = dda->distance;
+	// keep (um << 12) within 32 bits for moves longer than 1 m
+	if (distance >> 20) {
+		x >>= 8; y >>= 8; z >>= 8; e >>= 8;
+		distance >>= 8;
+	}
+
+	dir[0] = unit(x, distance);
+	dir[1] = unit(y, distance);
+	dir[2] = unit(z, distance);
+
+	// like c_limit in dda_create(), no axis may exceed its maximum feedrate
+	if (F > 0xFFFF)
+		F = 0xFFFF;
+	F = axis_limit(F, dir[0], MAXIMUM_FEEDRATE_X);
+	F = axis_limit(F, dir[1], MAXIMUM_FEEDRATE_Y);
+	F = axis_limit(F, dir[2], MAXIMUM_FEEDRATE_Z);
+	F = axis_limit(F, unit(e, distance), MAXIMUM_FEEDRATE_E);
+
+	if (dir[0] == 0 && dir[1] == 0 && dir[2] == 0) {
+		// extruder only moves, like retractions, start and end at standstill
+		dda->crossF = last_F = 0;
+		return;
+	}
+
+	if ( ! dda->x_direction)
+		dir[0] = -dir[0];
+	if ( ! dda->y_direction)
+		dir[1] = -dir[1];
+	if ( ! dda->z_direction)
+		dir[2] = -dir[2];
+
+	crossF = 0;
+	if (last_F) {
+		// cosine of the angle between both moves, 4096 = straight ahead
+		dot = ((int32_t) dir[0] * last_dir[0] + (int32_t) dir[1] * last_dir[1] +
+		       (int32_t) dir[2] * last_dir[2]) >> 12;
+		if (dot > 4096)
+			dot = 4096;
+		if (dot < -4096)
+			dot = -4096;
+
+		// sin(theta / 2) = sqrt((1 - cos(theta)) / 2), theta being the corner angle,
+		// which is 180 degrees minus the angle between both moves
+		sine = int_sqrt((uint32_t) (4096 + dot) << 11);
+
+		crossF = (last_F < F) ? last_F : F;
+		if (sine < 4095) {
+			// v^2 = a * deviation * sin(theta / 2) / (1 - sin(theta / 2))
+			junction_f2 = JUNCTION_F2 *
+			  ((last_accel < dda->acceleration) ? last_accel : dda->acceleration);
+			if (junction_f2 < (0xFFFFFFFF >> 12))
+				F2 = (junction_f2 * sine) / (4096 - sine);
+			else
+				F2 = (junction_f2 / (4096 - sine)) * sine;
+			if (int_sqrt(F2) < crossF)
+				crossF = int_sqrt(F2);
+		}
+	}
+	dda->crossF = crossF;
+
+	last_dir[0] = dir[0];
+	last_dir[1] = dir[1];
+	last_dir[2] = dir[2];
+	last_F = F;
+	last_accel = dda->acceleration;
+}
+
+/// the next move has to start at standstill
+void dda_lookahead_stop() {
+	last_F = 0;
+}
+
+/*! feedrate reachable at the end of a move
+	\param F feedrate at the start of the move [mm/min]
+	\param *dda the move
+	\return feedrate after accelerating over the full length of the move [mm/min]
+
+	This is also the highest feedrate from which we can decelerate to F within this move.
+*/
+static uint16_t accelerate(uint16_t F, DDA *dda) {
+	uint32_t F2 = (uint32_t) F * F;
+	uint32_t dF2 = 0xFFFFFFFF;
+	uint32_t f2_per_um = (dda->acceleration * F2_PER_UM_5) / 5;
+
+	if (f2_per_um == 0)
+		f2_per_um = 1;
+	if (dda->distance < 0xFFFFFFFF / f2_per_um)
+		dF2 = dda->distance * f2_per_um;
+	F2 = (F2 > 0xFFFFFFFF - dF2) ? 0xFFFFFFFF : F2 + dF2;
+
+	return int_sqrt(F2);
+}
+
+/*! number of ramp steps for a given feedrate
+	\param *dda the move
+	\param F feedrate [mm/min]
+	\param *c step time at this feedrate is stored here, 24.8 fixed point
+*/
+static uint32_t ramp_steps(DDA *dda, uint16_t F, uint32_t *c) {
+	uint32_t steps;
+
+	if (F == 0) {
+		*c = dda->c0;
+		return 0;
+	}
+	*c = dda_c_for_F(F, dda->distance, dda->total_steps);
+	if (*c <= dda->c_min) {
+		*c = dda->c_min;
+		return dda->cruise_steps;
+	}
+	steps = dda_accel_steps(*c >> 8, dda->distance, dda->total_steps, dda->acceleration);
+	return (steps < dda->cruise_steps) ? steps : dda->cruise_steps;
+}
+
+/*! calculate the ramps of a move
+	\param *dda the move
+	\param F_start entry feedrate [mm/min]
+	\param F_end exit feedrate [mm/min]
+
+	Results go to the next_* fields of the DDA, to be committed later.
+*/
+static void plan_ramps(DDA *dda, uint16_t F_start, uint16_t F_end) {
+	uint32_t start, end;
+
+	start = ramp_steps(dda, F_start, &(dda->next_start_c));
+	end = ramp_steps(dda, F_end, &(dda->next_end_c));
+
+	dda->next_start_steps = start;
+	dda_ramps(dda->total_steps, dda->cruise_steps, start, end,
+	          &(dda->next_rampup_steps), &(dda->next_rampdown_steps));
+}
+
+/*! plan all moves waiting in the movebuffer
+
+	Called from enqueue() after a new move was added.
+
+	Moves already started by the step interrupt are left alone, their exit
+	speed is the entry speed of the first move we plan. As the step interrupt
+	can start a move at any time, results are calculated into spare fields
+	first and committed for all moves at once with interrupts disabled. If
+	the interrupt picked up a move meanwhile, we start over.
+*/
+void dda_lookahead() {
+	uint8_t i, j, start, tail, done;
+	uint16_t F, F_exit;
+	DDA *dda;
+
+	do {
+		MEMORY_BARRIER();
+		tail = mb_tail;
+
+		// Backward pass: highest entry feedrate which still allows to stop at the
+		// end of the queue. Once a move keeps its value, all moves before it do so, too.
+		F_exit = 0;
+		for (i = mb_head; i != tail; i = MB_PREV(i)) {
+			dda = &movebuffer[i];
+			if (dda->nullmove)
+				continue;
+			if (dda->live || dda->waitfor_temp)
+				break;
+			F = accelerate(F_exit, dda);
+			if (F > dda->crossF)
+				F = dda->crossF;
+			if (F == dda->F_entry_max && i != mb_head)
+				break;
+			dda->F_entry_max = F;
+			F_exit = F;
+		}
+
+		// Start planning where the backward pass stopped, unless that move is fixed.
+		start = i;
+		if (i == tail || movebuffer[i].live || movebuffer[i].waitfor_temp)
+			start = MB_NEXT(i);
+		if (start == MB_NEXT(mb_head))
+			return;
+
+		// The entry feedrate of the first move is the exit feedrate of the move before.
+		F = 0;
+		for (j = MB_PREV(start); ; j = MB_PREV(j)) {
+			dda = &movebuffer[j];
+			if ( ! dda->nullmove) {
+				if ( ! dda->waitfor_temp && (dda->live || j != tail))
+					F = dda->F_end;
+				break;
+			}
+			if (j == tail)
+				break;
+		}
+
+		// Forward pass: accelerate as far as the next move allows.
+		for (i = start; ; i = MB_NEXT(i)) {
+			dda = &movebuffer[i];
+			if ( ! dda->nullmove) {
+				F_exit = 0;
+				for (j = i; j != mb_head; ) {
+					j = MB_NEXT(j);
+					if ( ! movebuffer[j].nullmove) {
+						F_exit = accelerate(F, dda);
+						if (F_exit > movebuffer[j].F_entry_max)
+							F_exit = movebuffer[j].F_entry_max;
+						break;
+					}
+				}
+				plan_ramps(dda, F, F_exit);
+				dda->next_F_end = F_exit;
+				F = F_exit;
+			}
+			if (i == mb_head)
+				break;
+		}
+
+		// Commit, if the first planned move is still waiting.
+		uint8_t save_reg = SREG;
+		cli();
+		CLI_SEI_BUG_MEMORY_BARRIER();
+
+		i = (start - mb_tail) & (MOVEBUFFER_SIZE - 1);
+		done = (i != 0 && i <= ((mb_head - mb_tail) & (MOVEBUFFER_SIZE - 1)));
+		if (done) {
+			for (i = start; ; i = MB_NEXT(i)) {
+				dda = &movebuffer[i];
+				if ( ! dda->nullmove) {
+					dda->start_steps = dda->next_start_steps;
+					dda->start_c = dda->next_start_c;
+					dda->end_c = dda->next_end_c;
+					dda->rampup_steps = dda->next_rampup_steps;
+					dda->rampdown_steps = dda->next_rampdown_steps;
+					dda->F_end = dda->next_F_end;
+				}
+				if (i == mb_head)
+					break;
+			}
+		}
+
+		MEMORY_BARRIER();
+		SREG = save_reg;
+	} while ( ! done);
+}
+
+#endif	/* LOOKAHEAD */
@@ -0,0 +1,22 @@
+#ifndef	_DDA_LOOKAHEAD_H
+#define	_DDA_LOOKAHEAD_H
+
+#include	<stdint.h>
+
+#include	"config.h"
+#include	"dda.h"
+
+#ifdef LOOKAHEAD
+
+// find the maximum feedrate at the junction with the previously created move
+void dda_find_crossing_speed(DDA *dda, uint32_t F);
+
+// the next move has to start at standstill, e.g. after waiting for temperatures
+void dda_lookahead_stop(void);
+
+// plan entry and exit speeds of all moves waiting in the movebuffer
+void dda_lookahead(void);
+
+#endif	/* LOOKAHEAD */
+
+#endif	/* _DDA_LOOKAHEAD_H */
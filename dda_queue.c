@@ -5,6 +5,7 @@
 */
 
 #include	<string.h>
+#include	<stdlib.h>
 #include	<avr/interrupt.h>
 
 #include	"config.h"
@@ -16,6 +17,23 @@
 #include	"sersendf.h"
 #include	"clock.h"
 #include	"memory_barrier.h"
+#include	"dda_lookahead.h"
+#include	"dda_util.h"
+#include	"profile.h"
+
+/*
+	The movebuffer is a single producer, single consumer queue without locks.
+	Moves are added by enqueue() outside of interrupts, the only writer of
+	mb_head. They're taken by next_move(), the only writer of mb_tail, called
+	from the step interrupt or, while the step interrupt is stopped, from
+	enqueue(). queue_flush() stops the step interrupt before touching mb_tail.
+	Both indices are single bytes, so reading them is atomic.
+
+	Whether the move at mb_tail still runs is the live flag of its DDA, which
+	only the step interrupt clears. As mb_tail never passes mb_head, the queue
+	is empty when both are equal and the move there isn't live, no matter
+	when the step interrupt strikes between these reads.
+*/
 
 /// movebuffer head pointer. Points to the last move in the queue.
 /// this variable is used both in and out of interrupts, but is
@@ -23,7 +41,8 @@
 uint8_t	mb_head = 0;
 
 /// movebuffer tail pointer. Points to the currently executing move
-/// this variable is read/written both in and out of interrupts.
+/// this variable is used both in and out of interrupts, but is
+/// only written by next_move() and queue_flush().
 uint8_t	mb_tail = 0;
 
 /// move buffer.
@@ -32,31 +51,28 @@ uint8_t	mb_tail = 0;
 /// once writing starts in interrupts on a specific slot, the
 /// slot will only be modified in interrupts until the slot is
 /// is no longer live.
-/// The size does not need to be a power of 2 anymore!
+/// The size has to be a power of 2, see dda_queue.h.
 DDA movebuffer[MOVEBUFFER_SIZE] __attribute__ ((__section__ (".bss")));
 
 /// check if the queue is completely full
 uint8_t queue_full() {
 	MEMORY_BARRIER();
-	if (mb_tail > mb_head) {
-		return ((mb_tail - mb_head - 1) == 0) ? 255 : 0;
-	} else {
-		return ((mb_tail + MOVEBUFFER_SIZE - mb_head - 1) == 0) ? 255 : 0;
-	}
+	return (((mb_tail - mb_head - 1) & (MOVEBUFFER_SIZE - 1)) == 0) ? 255 : 0;
+}
+
+/// number of moves which can be queued before the queue is full
+uint8_t queue_free() {
+	MEMORY_BARRIER();
+	return (mb_tail - mb_head - 1) & (MOVEBUFFER_SIZE - 1);
 }
 
 /// check if the queue is completely empty
 uint8_t queue_empty() {
-	uint8_t save_reg = SREG;
-	cli();
-	CLI_SEI_BUG_MEMORY_BARRIER();
-	
-	uint8_t result = ((mb_tail == mb_head) && (movebuffer[mb_tail].live == 0))?255:0;
+	uint8_t t;
 
 	MEMORY_BARRIER();
-	SREG = save_reg;
-
-	return result;
+	t = mb_tail;
+	return ((t == mb_head) && (movebuffer[t].live == 0)) ? 255 : 0;
 }
 
 // -------------------------------------------------------
@@ -65,6 +81,8 @@ uint8_t queue_empty() {
 // -------------------------------------------------------
 /// Take a step or go to the next move.
 void queue_step() {
+	PROFILE_START(QUEUE_STEP);
+
 	// do our next step
 	DDA* current_movebuffer = &movebuffer[mb_tail];
 	if (current_movebuffer->live) {
@@ -89,15 +107,22 @@ void queue_step() {
 	// the dda dies not directly after its last step, but when the timer fires and there's no steps to do
 	if (current_movebuffer->live == 0)
 		next_move();
+
+	PROFILE_END(QUEUE_STEP);
 }
 
 /// add a move to the movebuffer
+/// \param more more parts of the same move follow, so don't start an idle queue yet, unless it's full
 /// \note this function waits for space to be available if necessary, check queue_full() first if waiting is a problem
 /// This is the only function that modifies mb_head and it always called from outside an interrupt.
-void enqueue(TARGET *t) {
+static void enqueue_dda(TARGET *t, uint8_t more) {
 	// don't call this function when the queue is full, but just in case, wait for a move to complete and free up the space for the passed target
-	while (queue_full())
+	while (queue_full()) {
+		#ifdef STEP_RING_SIZE
+			dda_fill_ring();
+		#endif
 		delay(WAITING_DELAY);
+	}
 
 	uint8_t h = mb_head + 1;
 	h &= (MOVEBUFFER_SIZE - 1);
@@ -111,6 +136,9 @@ void enqueue(TARGET *t) {
 		// it's a wait for temp
 		new_movebuffer->waitfor_temp = 1;
 		new_movebuffer->nullmove = 0;
+		#ifdef LOOKAHEAD
+			dda_lookahead_stop();
+		#endif
 	}
 
 	// make certain all writes to global memory
@@ -118,17 +146,20 @@ void enqueue(TARGET *t) {
 	MEMORY_BARRIER();
 	
 	mb_head = h;
-	
-	uint8_t save_reg = SREG;
-	cli();
-	CLI_SEI_BUG_MEMORY_BARRIER();
 
-	uint8_t isdead = (movebuffer[mb_tail].live == 0);
-	
+	#ifdef LOOKAHEAD
+		// join the new move to the ones waiting in the queue, before it may get started
+		if (t != NULL)
+			dda_lookahead();
+	#endif
+
+	// A running step interrupt picks up the new move by itself. If the move at
+	// the tail isn't live, the step interrupt found the queue empty and stopped,
+	// or isn't running at all, as it clears live and moves on in one go.
 	MEMORY_BARRIER();
-	SREG = save_reg;
-	
-	if (isdead) {
+	uint8_t isdead = (movebuffer[mb_tail].live == 0);
+
+	if (isdead && (more == 0 || queue_full())) {
 		timer1_compa_deferred_enable = 0;
 		next_move();
 		if (timer1_compa_deferred_enable) {
@@ -144,6 +175,51 @@ void enqueue(TARGET *t) {
 	}	
 }
 
+/// add a move to the movebuffer, NULL to wait for temperatures
+/// \note this function waits for space to be available if necessary, check queue_full() first if waiting is a problem
+///
+/// A DDA moves each axis up to MAX_DELTA steps, longer moves take several DDAs.
+void enqueue(TARGET *t) {
+	TARGET start, part;
+	uint32_t d, longest = 0;
+	uint16_t k, n;
+
+	if (t != NULL) {
+		d = labs(t->X - startpoint.X);
+		if (d > longest)
+			longest = d;
+		d = labs(t->Y - startpoint.Y);
+		if (d > longest)
+			longest = d;
+		d = labs(t->Z - startpoint.Z);
+		if (d > longest)
+			longest = d;
+		d = labs(t->E - startpoint.E);
+		if (d > longest)
+			longest = d;
+
+		if (longest > MAX_DELTA) {
+			n = (longest + MAX_DELTA - 1) / MAX_DELTA;
+			start = startpoint;
+			part = *t;
+			for (k = 1; k <= n; k++) {
+				part.X = start.X + delta_part(t->X - start.X, k, n);
+				part.Y = start.Y + delta_part(t->Y - start.Y, k, n);
+				part.Z = start.Z + delta_part(t->Z - start.Z, k, n);
+				#ifdef E_ABSOLUTE
+					part.E = start.E + delta_part(t->E - start.E, k, n);
+				#else
+					// E is relative to the previous part
+					part.E = delta_part(t->E, k, n) - delta_part(t->E, k - 1, n);
+				#endif
+				enqueue_dda(&part, k < n);
+			}
+			return;
+		}
+	}
+	enqueue_dda(t, 0);
+}
+
 /// go to the next move.
 /// be aware that this is sometimes called from interrupt context, sometimes not.
 /// Note that if it is called from outside an interrupt it must not/can not by
@@ -153,6 +229,8 @@ void enqueue(TARGET *t) {
 /// move buffer was dead in the non-interrupt case (which indicates that the 
 /// timer interrupt is disabled).
 void next_move() {
+	PROFILE_START(NEXT_MOVE);
+
 	while ((queue_empty() == 0) && (movebuffer[mb_tail].live == 0)) {
 		// next item
 		uint8_t t = mb_tail + 1;
@@ -176,6 +254,7 @@ void next_move() {
 	if (queue_empty())
 		setTimer(0);
 
+	PROFILE_END(NEXT_MOVE);
 }
 
 /// DEBUG - print queue.
@@ -208,6 +287,9 @@ void queue_flush() {
 /// wait for queue to empty
 void queue_wait() {
 	for (;queue_empty() == 0;) {
+		#ifdef STEP_RING_SIZE
+			dda_fill_ring();
+		#endif
 		ifclock(clock_flag_10ms) {
 			clock_10ms();
 		}
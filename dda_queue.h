@@ -6,6 +6,10 @@
 
 #define HEATER_WAIT_TIMEOUT 1000 MS
 
+#if MOVEBUFFER_SIZE & (MOVEBUFFER_SIZE - 1)
+	#error MOVEBUFFER_SIZE has to be a power of 2.
+#endif
+
 /*
 	variables
 */
@@ -22,6 +26,7 @@ extern DDA movebuffer[MOVEBUFFER_SIZE];
 // queue status methods
 uint8_t queue_full(void);
 uint8_t queue_empty(void);
+uint8_t queue_free(void);
 
 // take one step
 void queue_step(void);
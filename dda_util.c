@@ -130,4 +130,12 @@ const uint8_t	msbloc (uint32_t v) {
 	return 0;
 }
 
-
+/*! share of a distance covered after k of n segments
+	\param delta the whole distance
+	\param k number of segments done
+	\param n number of segments
+	\return \f$\Delta \cdot k / n\f$ without overflowing
+*/
+int32_t delta_part(int32_t delta, uint16_t k, uint16_t n) {
+	return (delta / n) * k + ((delta % n) * k) / n;
+}
@@ -11,5 +11,8 @@ const uint8_t	msbloc (uint32_t v)																		__attribute__ ((const));
 
 uint16_t int_sqrt( uint32_t a);
 
+// share of a distance covered after k of n segments
+int32_t delta_part(int32_t delta, uint16_t k, uint16_t n);
+
 #endif
 
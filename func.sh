@@ -177,17 +177,90 @@ mendel_cmd_hr() {
 }
 
 # Print a gcode file. Echos commands and replies.
+# With OK_CREDITS, lines are sent ahead as long as they fit into the free
+# receive buffer space reported with each ok ("R:<bytes>"), less the lines
+# sent since the acknowledged one. Without, each line waits for its ok.
+# On a resend request, all lines in flight are sent again, from the oldest.
 mendel_print() {
 	(
+		local INFLIGHT=()
+		local SENT=0
+		local FREE=0
+		local RSC=0
+		local REPLY=""
+
+		# wait for the next ok or resend request
+		mendel_print_reply() {
+			REPLY=""
+			while ! [[ "$REPLY" =~ ^OK ]] && ! [[ "$REPLY" =~ ^ok ]] && ! [[ "$REPLY" =~ ^RESEND ]] && ! [[ "$REPLY" =~ ^rs ]]
+			do
+				read -u 3
+				echo "<R $REPLY"
+			done
+		}
+
+		# wait for the reply to the oldest line in flight
+		mendel_print_ack() {
+			local L
+			local N
+			mendel_print_reply
+			if [[ "$REPLY" =~ ^RESEND ]] || [[ "$REPLY" =~ ^rs ]]
+			then
+				# numbered lines after it are refused as well, collect their replies
+				for (( N = 1; N < ${#INFLIGHT[@]}; N++ ))
+				do
+					mendel_print_reply
+				done
+				if [ "$RSC" -le 3 ]
+				then
+					RSC=$(( $RSC + 1 ))
+				else
+					echo "Too many retries: aborting" >&2
+					RSC=0
+					SENT=$(( $SENT - ${#INFLIGHT[0]} - 1 ))
+					INFLIGHT=("${INFLIGHT[@]:1}")
+				fi
+				for L in "${INFLIGHT[@]}"
+				do
+					echo "$L" >&3
+					echo "S> $L"
+				done
+				# unknown until the next ok
+				FREE=-1
+				return
+			fi
+			RSC=0
+			SENT=$(( $SENT - ${#INFLIGHT[0]} - 1 ))
+			INFLIGHT=("${INFLIGHT[@]:1}")
+			if [[ "$REPLY" =~ R:([0-9]+) ]]
+			then
+				FREE=${BASH_REMATCH[1]}
+			else
+				FREE=-1
+			fi
+		}
+
 		for F in "$@"
 		do
 			local IFS=$'\n'
 			for L in $(< $F)
 			do
-				mendel_cmd_hr "$L"
+				local LEN=$(( ${#L} + 1 ))
+				while [ ${#INFLIGHT[@]} -gt 0 ] && [ $(( $SENT + $LEN )) -gt $FREE ]
+				do
+					mendel_print_ack
+				done
+				echo "$L" >&3
+				echo "S> $L"
+				INFLIGHT+=("$L")
+				SENT=$(( $SENT + $LEN ))
 			done
 		done
-	)
+		while [ ${#INFLIGHT[@]} -gt 0 ]
+		do
+			mendel_print_ack
+		done
+	) 3<>$MENDEL_DEV;
 }
 
 # Print a gcode file. Press a key after each line. Echos commands and replies.
@@ -0,0 +1,177 @@
+#!/usr/bin/python
+# -*- coding: utf-8 -*-
+#
+# Converts G-code into Teacup's binary transport, see gcode_binary.c
+#
+# Usage: gcode2bin.py [-e] steps_per_mm_x steps_per_mm_y steps_per_mm_z steps_per_mm_e < file.gcode > file.bin
+#
+# Steps per mm have to be the same as in the firmware's config.h, -e is for
+# firmware with E_ABSOLUTE defined. G1 moves become binary frames. G0
+# moves, which run at their own feedrate, and everything else are sent as
+# G-code, switching back to binary with M252 afterwards. A sender has to
+# wait for an ok after each line or frame, just as for G-code.
+#
+# Frames skip the firmware's axis limits and its carrying of rounding
+# fractions, so this script carries the fractions of relative moves itself.
+# It doesn't know the axis limits, make sure the G-code stays within them.
+
+import re
+import struct
+import sys
+
+SYNC = 0xA5
+FLAG_F = 0x10
+FLAG_LONG = 0x20
+FLAG_LEAVE = 0x80
+
+AXES = "XYZE"
+
+def crc16(data):
+	"""Same as avr-libc's _crc16_update(), starting at 0."""
+	crc = 0
+	for b in bytearray(data):
+		crc ^= b
+		for i in range(8):
+			if crc & 1:
+				crc = (crc >> 1) ^ 0xA001
+			else:
+				crc >>= 1
+	return crc
+
+class Encoder:
+	def __init__(self, steps_per_mm, e_absolute, out):
+		self.steps_per_mm = steps_per_mm
+		self.e_absolute = e_absolute
+		self.out = out
+		self.position = [0, 0, 0, 0]		# where the firmware is [steps]
+		self.fraction = [0.0, 0.0, 0.0, 0.0]	# left over by rounding relative moves [steps]
+		self.relative = False
+		self.binary = False
+		self.sequence = 0
+		self.F = None
+
+	def frame(self, flags, deltas, F):
+		if [d for d in deltas if d < -32768 or d > 32767]:
+			flags |= FLAG_LONG
+		body = b""
+		for i in range(4):
+			if deltas[i]:
+				flags |= 1 << i
+				body += struct.pack("<i" if flags & FLAG_LONG else "<h", deltas[i])
+		if F is not None:
+			flags |= FLAG_F
+			body += struct.pack("<H", min(F, 0xFFFF))
+		data = struct.pack("<BB", flags, self.sequence & 0xFF) + body
+		self.out.write(struct.pack("<B", SYNC) + data + struct.pack("<H", crc16(data)))
+		self.sequence += 1
+
+	def gcode(self, line):
+		if self.binary:
+			self.frame(FLAG_LEAVE, [0, 0, 0, 0], None)
+			self.binary = False
+		self.out.write(line.encode("ascii") + b"\n")
+		# G-code may change the feedrate, send it with the next frame
+		self.F = None
+
+	def steps(self, words, i):
+		return int(round(words[AXES[i]] * self.steps_per_mm[i]))
+
+	def relative_steps(self, words, i):
+		"""Carry what rounding leaves over to the next relative move, as the
+		firmware does for G-code, so many short moves don't drift."""
+		exact = words[AXES[i]] * self.steps_per_mm[i] + self.fraction[i]
+		steps = int(round(exact))
+		self.fraction[i] = exact - steps
+		return steps
+
+	def track(self, words):
+		"""Follow the position for moves sent as G-code."""
+		for i in range(4):
+			if AXES[i] not in words or i == 3 and not self.e_absolute:
+				continue
+			if self.relative:
+				self.position[i] += self.relative_steps(words, i)
+			else:
+				self.position[i] = self.steps(words, i)
+
+	def move(self, words):
+		deltas = [0, 0, 0, 0]
+		for i in range(4):
+			if AXES[i] not in words:
+				continue
+			if i == 3 and not self.e_absolute:
+				# E is always relative in Teacup, unless E_ABSOLUTE
+				deltas[i] = self.relative_steps(words, i)
+			elif self.relative:
+				deltas[i] = self.relative_steps(words, i)
+				self.position[i] += deltas[i]
+			else:
+				deltas[i] = self.steps(words, i) - self.position[i]
+				self.position[i] += deltas[i]
+		F = None
+		if "F" in words and int(words["F"]) != self.F:
+			F = self.F = int(words["F"])
+		if not self.binary:
+			self.out.write(b"M252\n")
+			self.binary = True
+			self.sequence = 0
+		self.frame(0, deltas, F)
+
+	def line(self, line):
+		line = re.sub(r"\(.*?\)|;.*", "", line).strip().upper()
+		if not line:
+			return
+		words = dict((w, float(v)) for w, v in re.findall(r"([A-Z])\s*([-+]?[0-9.]+)", line))
+		if "M" not in words and ("G" in words or [a for a in AXES + "F" if a in words]):
+			G = words.get("G", 1)
+			if G == 1:
+				self.move(words)
+				return
+			elif G == 20:
+				sys.exit("inches aren't supported")
+			elif G == 90:
+				self.relative = False
+			elif G == 91:
+				self.relative = True
+			elif G == 92:
+				# axes may come without a value, which means 0
+				named = [i for i in range(4) if AXES[i] in line]
+				for i in named:
+					# like the parser, start from the fraction of the new position
+					words.setdefault(AXES[i], 0.0)
+					self.fraction[i] = 0.0
+					self.position[i] = self.relative_steps(words, i)
+				if not named:
+					# the firmware sets X, Y and Z to 0
+					for i in range(3):
+						self.position[i] = 0
+						self.fraction[i] = 0.0
+			elif G == 28:
+				named = [i for i in range(3) if AXES[i] in line]
+				for i in named:
+					self.position[i] = 0
+				if not named:
+					# no axis named homes X, Y and Z
+					for i in range(3):
+						self.position[i] = 0
+						self.fraction[i] = 0.0
+			elif G in (0, 2, 3):
+				self.track(words)
+		self.gcode(line)
+
+def main(argv):
+	e_absolute = False
+	if argv and argv[0] == "-e":
+		e_absolute = True
+		argv = argv[1:]
+	if len(argv) != 4:
+		sys.exit("usage: gcode2bin.py [-e] steps_per_mm_x steps_per_mm_y steps_per_mm_z steps_per_mm_e < file.gcode > file.bin")
+	out = getattr(sys.stdout, "buffer", sys.stdout)
+	encoder = Encoder([float(a) for a in argv], e_absolute, out)
+	for line in sys.stdin:
+		encoder.line(line)
+	if encoder.binary:
+		encoder.frame(FLAG_LEAVE, [0, 0, 0, 0], None)
+
+if __name__ == "__main__":
+	main(sys.argv[1:])
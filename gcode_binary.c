@@ -0,0 +1,162 @@
+#include	"gcode_binary.h"
+
+/** \file
+	\brief Binary G-code transport - receive moves as packed frames
+
+	Parsing G-code costs a decimal to binary conversion for each word, and a
+	G1 with three axes and a feedrate takes some 35 bytes on the wire. After
+	M252 a host can send moves as binary frames instead, already scaled to
+	steps, which take 9 to 23 bytes. Frames go straight into enqueue(),
+	bypassing process_gcode_command() and the G-code parser. So X_MIN, X_MAX
+	and the other axis limits aren't applied, and the fractions of a step
+	left over by rounding aren't carried from one move to the next, see
+	gcode_parse.c. Both are up to the host.
+
+	A frame is, all values little endian:
+
+		0xA5        sync byte
+		flags       bit 0..3: X, Y, Z, E present
+		            bit 4: F present
+		            bit 5: distances are 32 bit instead of 16 bit
+		            bit 7: back to G-code after this frame
+		sequence    frame number, counting up from 0 after M252
+		X, Y, Z, E  distance from the end of the previous move [steps], signed
+		F           feedrate [mm/min], 16 bit
+		crc         crc16 of everything from flags to F, as done by crc_block()
+
+	Axes not present don't move, without F the previous feedrate is kept.
+
+	A good frame is answered with "ok <sequence>". A frame with a bad crc or
+	an unexpected sequence number is dropped and answered with
+	"rs <expected sequence>", the host should send again from there. The
+	frame before the expected one, sent again because its ok got lost, is
+	answered with ok without queueing the move a second time. Bytes outside
+	of frames are ignored.
+*/
+
+#include	"crc.h"
+#include	"dda_queue.h"
+#include	"gcode_parse.h"
+#include	"sersendf.h"
+
+#ifdef BINARY_GCODE
+
+#define	BINARY_SYNC		0xA5
+
+/// frame flags
+#define	BINARY_F			0x10
+#define	BINARY_LONG		0x20
+#define	BINARY_LEAVE	0x80
+
+uint8_t binary_mode = 0;
+
+/// the frame being received
+static struct {
+	uint8_t		data[22];		///< frame from flags to crc
+	uint8_t		length;			///< bytes expected in data, 0 while waiting for sync
+	uint8_t		index;			///< bytes received so far
+	uint8_t		sequence;		///< sequence number of the next frame expected
+} frame;
+
+/*! length of a frame without sync byte
+	\param flags flags of the frame
+*/
+static uint8_t binary_length(uint8_t flags) {
+	uint8_t length = 4, i;
+
+	for (i = 0; i < 4; i++)
+		if (flags & (1 << i))
+			length += (flags & BINARY_LONG) ? 4 : 2;
+	if (flags & BINARY_F)
+		length += 2;
+	return length;
+}
+
+/// queue the move of a complete frame
+static void binary_frame(void) {
+	uint8_t flags = frame.data[0], i;
+	uint8_t *p = &frame.data[2];
+	int32_t delta[4] = { 0, 0, 0, 0 };
+	TARGET t;
+
+	if (crc_block(frame.data, frame.length - 2) !=
+	    (uint16_t) (frame.data[frame.length - 2] | (frame.data[frame.length - 1] << 8))) {
+		sersendf_P(PSTR("rs %u\n"), frame.sequence);
+		return;
+	}
+	if (frame.data[1] != frame.sequence) {
+		if (frame.data[1] == (uint8_t) (frame.sequence - 1))
+			sersendf_P(PSTR("ok %u\n"), frame.data[1]);
+		else
+			sersendf_P(PSTR("rs %u\n"), frame.sequence);
+		return;
+	}
+
+	for (i = 0; i < 4; i++) {
+		if ((flags & (1 << i)) == 0)
+			continue;
+		if (flags & BINARY_LONG) {
+			delta[i] = p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+			p += 4;
+		}
+		else {
+			delta[i] = (int16_t) (p[0] | (p[1] << 8));
+			p += 2;
+		}
+	}
+	if (flags & BINARY_F)
+		next_target.target.F = (uint16_t) (p[0] | (p[1] << 8));
+
+	if (flags & 0x0F) {
+		// startpoint is where the previous move ends, E being relative unless E_ABSOLUTE
+		t = startpoint;
+		t.X += delta[0];
+		t.Y += delta[1];
+		t.Z += delta[2];
+		t.E += delta[3];
+		t.F = next_target.target.F;
+		enqueue(&t);
+	}
+
+	sersendf_P(PSTR("ok %u\n"), frame.sequence);
+	frame.sequence++;
+	if (flags & BINARY_LEAVE)
+		binary_mode = 0;
+}
+
+/** switch to binary frames
+
+	Called from process_gcode_command(), so the ok to the M-code is sent
+	before the host starts sending frames.
+*/
+void binary_start() {
+	frame.length = 0;
+	frame.sequence = 0;
+	binary_mode = 255;
+}
+
+/*! accept the next byte of a frame
+	\param c the byte received
+
+	Complete frames are acted upon right away. As this may queue a move,
+	there has to be room in the movebuffer.
+*/
+void binary_parse_char(uint8_t c) {
+	if (frame.length == 0) {
+		if (c == BINARY_SYNC) {
+			frame.index = 0;
+			frame.length = 1;
+		}
+		return;
+	}
+
+	frame.data[frame.index++] = c;
+	if (frame.index == 1)
+		frame.length = binary_length(c);
+	if (frame.index == frame.length) {
+		binary_frame();
+		frame.length = 0;
+	}
+}
+
+#endif	/* BINARY_GCODE */
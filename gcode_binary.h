@@ -0,0 +1,21 @@
+#ifndef	_GCODE_BINARY_H
+#define	_GCODE_BINARY_H
+
+#include	<stdint.h>
+
+#include	"config.h"
+
+#ifdef BINARY_GCODE
+
+/// true while moves are received as binary frames instead of G-code
+extern uint8_t binary_mode;
+
+// switch to binary frames after the current G-code command
+void binary_start(void);
+
+// accept the next byte of a binary frame
+void binary_parse_char(uint8_t c);
+
+#endif	/* BINARY_GCODE */
+
+#endif	/* _GCODE_BINARY_H */
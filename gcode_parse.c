@@ -5,6 +5,7 @@
 */
 
 #include	<string.h>
+#include	<avr/pgmspace.h>
 
 #include	"serial.h"
 #include	"sermsg.h"
@@ -16,32 +17,13 @@
 #include	"gcode_process.h"
 
 /*
-	Switch user friendly values to coding friendly values
-
-	This also affects the possible build volume. We have +/- 2^31 numbers available and as we internally measure position in steps and use a precision factor of 1000, this translates into a possible range of
-
-		2^31 mm / STEPS_PER_MM_x / 1000
-
-	for each axis. For a M6 threaded rod driven machine and 1/16 microstepping this evaluates to
-
-		2^31 mm / 200 / 16 / 1000 = 671 mm,
-
-	which is about the worst case we have. All other machines have a bigger build volume.
+	mm -> inch conversion, steps per 1000 inches
 */
 
-#define	STEPS_PER_M_X			((uint32_t) ((STEPS_PER_MM_X * 1000.0) + 0.5))
-#define	STEPS_PER_M_Y			((uint32_t) ((STEPS_PER_MM_Y * 1000.0) + 0.5))
-#define	STEPS_PER_M_Z			((uint32_t) ((STEPS_PER_MM_Z * 1000.0) + 0.5))
-#define	STEPS_PER_M_E			((uint32_t) ((STEPS_PER_MM_E * 1000.0) + 0.5))
-
-/*
-	mm -> inch conversion
-*/
-
-#define	STEPS_PER_IN_X		((uint32_t) ((25.4 * STEPS_PER_MM_X) + 0.5))
-#define	STEPS_PER_IN_Y		((uint32_t) ((25.4 * STEPS_PER_MM_Y) + 0.5))
-#define	STEPS_PER_IN_Z		((uint32_t) ((25.4 * STEPS_PER_MM_Z) + 0.5))
-#define	STEPS_PER_IN_E		((uint32_t) ((25.4 * STEPS_PER_MM_E) + 0.5))
+#define	STEPS_PER_KIN_X		((uint32_t) ((25400. * STEPS_PER_MM_X) + 0.5))
+#define	STEPS_PER_KIN_Y		((uint32_t) ((25400. * STEPS_PER_MM_Y) + 0.5))
+#define	STEPS_PER_KIN_Z		((uint32_t) ((25400. * STEPS_PER_MM_Z) + 0.5))
+#define	STEPS_PER_KIN_E		((uint32_t) ((25400. * STEPS_PER_MM_E) + 0.5))
 
 /// current or previous gcode word
 /// for working out what to do with data just received
@@ -53,28 +35,48 @@ uint8_t last_field = 0;
 /// crude floating point data storage
 decfloat read_digit					__attribute__ ((__section__ (".bss")));
 
+/// digits are taken while the mantissa is below this, depends on the word
+static uint32_t mantissa_max = 0;
+
 /// this is where we store all the data for the current command before we work out what to do with it
 GCODE_COMMAND next_target		__attribute__ ((__section__ (".bss")));
 
+/** fractions of a step left over by rounding X, Y, Z and E [1/10^8 steps]
+
+	Rounding each relative word to whole steps on its own loses up to half a
+	step per move, which adds up over thousands of short extruding moves. So
+	what is left over is carried into the next word of the same axis and the
+	sum of all moves matches the G-code exactly. Absolute words and those
+	of G92, E included, start from their own fraction, dropping what was
+	carried for their axis. The parser works on fractions_next, taken over
+	only when the line is accepted, so a line sent again after a bad
+	checksum doesn't count twice.
+*/
+static int32_t fractions[4], fractions_next[4];
+
 /*
+	Lengths, X, Y, Z, E, I, J and R, are converted by decfloat_to_length(), which takes up to 5 decimals and up to +-9999.99999 mm or +-393.70078 inches, see there. All other words go through decfloat_to_int().
+
 	decfloat_to_int() is the weakest subject to variable overflow. For evaluation, we assume a build room of +-1000 mm and STEPS_PER_MM_x between 1.000 and 4096. Accordingly for metric units:
 
 		df->mantissa:  +-0..1048075    (20 bit - 500 for rounding)
-		df->exponent:  0, 2, 3 or 4    (10 bit)
+		df->exponent:  0, 2 .. 6       (17 bit)
 		multiplicand / denominator:  20..4194303 / 1000 (22 bit - 10 bit) or
 		                              0..4095 / 1       (12 bit -  0 bit)
 
 	imperial units:
 
 		df->mantissa:  +-0..32267      (15 bit - 500 for rounding)
-		df->exponent:  0, 2, 3 or 4    (10 bit)
+		df->exponent:  0, 2 .. 6       (17 bit)
 		multiplicand:  1..105000       (17 bit)
 		denominator:   1 or 10         ( 4 bit)
 */
 // accordingly:
-#define	DECFLOAT_EXP_MAX 4
+#define	DECFLOAT_EXP_MAX 6
 #define	DECFLOAT_MANT_MM_MAX 1048075
 #define	DECFLOAT_MANT_IN_MAX 32267
+// lengths, up to 9 digits
+#define	DECFLOAT_MANT_LENGTH_MAX 100000000
 
 /*
 	utility functions
@@ -112,216 +114,344 @@ static int32_t decfloat_to_int(decfloat *df, uint32_t multiplicand, uint8_t divi
 	return df->sign ? -(int32_t)r : (int32_t)r;
 }
 
+/// a length unit, in units per meter (mm) or per 1000 inches, split into two base 10000 digits
+typedef struct {
+	uint16_t	hi;				///< units / 10000
+	uint16_t	lo;				///< units % 10000
+} LENGTH_UNIT;
+
+#define	LENGTH_UNIT(units)	{ (units) / 10000, (units) % 10000 }
+
+/// length units for X, Y, Z, E [steps] and I, J, R [um], for mm and for inches
+static const LENGTH_UNIT length_units[2][5] PROGMEM = {
+	{
+		LENGTH_UNIT(STEPS_PER_M_X), LENGTH_UNIT(STEPS_PER_M_Y),
+		LENGTH_UNIT(STEPS_PER_M_Z), LENGTH_UNIT(STEPS_PER_M_E),
+		LENGTH_UNIT(1000000UL)
+	},
+	{
+		LENGTH_UNIT(STEPS_PER_KIN_X), LENGTH_UNIT(STEPS_PER_KIN_Y),
+		LENGTH_UNIT(STEPS_PER_KIN_Z), LENGTH_UNIT(STEPS_PER_KIN_E),
+		LENGTH_UNIT(25400000UL)
+	}
+};
+
+/// index of I, J and R in length_units
+#define	LENGTH_UM	4
+
+/** convert a length into steps or um, exactly
+	\param *df the length, mm or inches as set by G20/G21
+	\param unit X, Y, Z, E or LENGTH_UM, index in length_units
+	\param *fraction fraction of a unit [1/10^8] added before rounding and left over after, NULL to just round
+
+	The result is value * units, rounded to the nearest integer, without
+	losing any digits in between. The value is scaled to 5 decimals,
+	m < 10^9, units u are per meter or per 1000 inches, so the result is
+	m * u / 10^8. With m = m1 * 10^4 + m0 and u = u1 * 10^4 + u0 this is
+
+		m1 * u1 + (m1 * u0 + m0 * u1) / 10^4 + m0 * u0 / 10^8
+
+	where all products fit into 32 bits for units up to 4096 steps per mm.
+	Carrying the remainders of the last two terms gives exact rounding.
+*/
+static int32_t decfloat_to_length(decfloat *df, uint8_t unit, int32_t *fraction) {
+	const LENGTH_UNIT *u = &length_units[next_target.option_inches ? 1 : 0][unit];
+	uint16_t	u1 = pgm_read_word(&u->hi), u0 = pgm_read_word(&u->lo);
+	uint32_t	m = df->mantissa, m1, t, q, r;
+	int32_t	s, f;
+	uint16_t	m0;
+	uint8_t	e = df->exponent;
+
+	// decimals seen, see decfloat_to_int()
+	if (e)
+		e--;
+
+	// scale to 5 decimals, saturating beyond 10^4 mm or inches
+	if (m >= powers[4 + e])
+		m = 999999999;
+	else
+		m *= powers[5 - e];
+
+	m1 = m / 10000;
+	m0 = m % 10000;
+	t = m1 * u0 + (uint32_t) m0 * u1;
+	q = m1 * u1 + t / 10000;
+	r = (t % 10000) * 10000 + (uint32_t) m0 * u0;
+	if (r >= 100000000) {
+		q++;
+		r -= 100000000;
+	}
+
+	// s + f / 10^8 is the exact value
+	s = q;
+	f = r;
+	if (df->sign) {
+		s = -s;
+		f = -f;
+	}
+	if (fraction)
+		f += *fraction;
+
+	// round to nearest, half away from zero
+	if (f >= 50000000) {
+		s++;
+		f -= 100000000;
+	}
+	else if (f <= -50000000) {
+		s--;
+		f += 100000000;
+	}
+	if (fraction)
+		*fraction = f;
+
+	return s;
+}
+
+/// forget the fractions carried for X, Y and Z, for when their position is set anew
+void gcode_clear_fractions(void) {
+	fractions[0] = fractions[1] = fractions[2] = 0;
+}
+
+/*
+	character classes
+
+	Each character is looked up once in char_class[]. Letters of known words
+	map to the bit number of their seen_* flag in next_target.flags, all
+	other characters to one of the classes below. This replaces a chain of
+	range checks and two big switches per character.
+*/
+
+/// bit numbers of the seen_* flags in next_target.flags, in the order of GCODE_COMMAND
+#define	SEEN_G					0
+#define	SEEN_M					1
+#define	SEEN_X					2
+#define	SEEN_Y					3
+#define	SEEN_Z					4
+#define	SEEN_E					5
+#define	SEEN_F					6
+#define	SEEN_S					7
+#define	SEEN_P					8
+#define	SEEN_T					9
+#define	SEEN_N					10
+#define	SEEN_CHECKSUM		11
+#define	SEEN_I					16
+#define	SEEN_J					17
+#define	SEEN_R					18
+
+/// character classes beyond the seen_* flags
+#define	CC_LETTER				32	///< other letters, start a field which is ignored
+#define	CC_DIGIT				33
+#define	CC_MINUS				34
+#define	CC_DOT					35
+#define	CC_SEMI					36	///< comment up to the end of the line
+#define	CC_PARENS				37	///< comment up to the closing parenthesis
+#define	CC_EOL					38
+#define	CC_BLANK				39
+#define	CC_OTHER				40
+
+/// class of each ASCII character, lowercase letters are converted before lookup
+static const uint8_t char_class[128] PROGMEM = {
+	[0 ... 127] = CC_OTHER,
+	['A' ... 'Z'] = CC_LETTER,
+	['0' ... '9'] = CC_DIGIT,
+	['G'] = SEEN_G, ['M'] = SEEN_M,
+	['X'] = SEEN_X, ['Y'] = SEEN_Y, ['Z'] = SEEN_Z, ['E'] = SEEN_E, ['F'] = SEEN_F,
+	['S'] = SEEN_S, ['P'] = SEEN_P, ['T'] = SEEN_T, ['N'] = SEEN_N, ['*'] = SEEN_CHECKSUM,
+	#ifdef ARC_SUPPORT
+	['I'] = SEEN_I, ['J'] = SEEN_J, ['R'] = SEEN_R,
+	#endif
+	['-'] = CC_MINUS, ['.'] = CC_DOT, [';'] = CC_SEMI, ['('] = CC_PARENS,
+	[10] = CC_EOL, [13] = CC_EOL, [' '] = CC_BLANK, ['\t'] = CC_BLANK,
+};
+
 /// Character Received - add it to our command
 /// \param c the next character to process
 void gcode_parse_char(uint8_t c) {
+	uint8_t cc, w;
+
 	// uppercase
 	if (c >= 'a' && c <= 'z')
 		c &= ~32;
 
-	// process previous field
-	if (last_field) {
-		// check if we're seeing a new field or end of line
-		// any character will start a new field, even invalid/unknown ones
-		if ((c >= 'A' && c <= 'Z') || c == '*' || (c == 10) || (c == 13)) {
-			switch (last_field) {
-				case 'G':
-					next_target.G = read_digit.mantissa;
-					if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
-						serwrite_uint8(next_target.G);
-					break;
-				case 'M':
-					next_target.M = read_digit.mantissa;
-					if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
-						serwrite_uint8(next_target.M);
-					break;
-				case 'X':
-					if (next_target.option_inches)
-						next_target.target.X = decfloat_to_int(&read_digit, STEPS_PER_IN_X, 0);
-					else
-						next_target.target.X = decfloat_to_int(&read_digit, STEPS_PER_M_X, 1);
-					if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
-						serwrite_int32(next_target.target.X);
-					break;
-				case 'Y':
-					if (next_target.option_inches)
-						next_target.target.Y = decfloat_to_int(&read_digit, STEPS_PER_IN_Y, 0);
-					else
-						next_target.target.Y = decfloat_to_int(&read_digit, STEPS_PER_M_Y, 1);
-					if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
-						serwrite_int32(next_target.target.Y);
-					break;
-				case 'Z':
-					if (next_target.option_inches)
-						next_target.target.Z = decfloat_to_int(&read_digit, STEPS_PER_IN_Z, 0);
-					else
-						next_target.target.Z = decfloat_to_int(&read_digit, STEPS_PER_M_Z, 1);
-					if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
-						serwrite_int32(next_target.target.Z);
-					break;
-				case 'E':
-					if (next_target.option_inches)
-						next_target.target.E = decfloat_to_int(&read_digit, STEPS_PER_IN_E, 0);
-					else
-						next_target.target.E = decfloat_to_int(&read_digit, STEPS_PER_M_E, 1);
-					if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
-						serwrite_uint32(next_target.target.E);
-					break;
-				case 'F':
-					// just use raw integer, we need move distance and n_steps to convert it to a useful value, so wait until we have those to convert it
-					if (next_target.option_inches)
-						next_target.target.F = decfloat_to_int(&read_digit, 25400, 1);
-					else
-						next_target.target.F = decfloat_to_int(&read_digit, 1, 0);
-					if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
-						serwrite_uint32(next_target.target.F);
-					break;
-				case 'S':
-					// if this is temperature, multiply by 4 to convert to quarter-degree units
-					// cosmetically this should be done in the temperature section,
-					// but it takes less code, less memory and loses no precision if we do it here instead
-					if ((next_target.M == 104) || (next_target.M == 109) || (next_target.M == 140))
-						next_target.S = decfloat_to_int(&read_digit, 4, 0);
-					// if this is heater PID stuff, multiply by PID_SCALE because we divide by PID_SCALE later on
-					else if ((next_target.M >= 130) && (next_target.M <= 132))
-						next_target.S = decfloat_to_int(&read_digit, PID_SCALE, 0);
-					else
-						next_target.S = decfloat_to_int(&read_digit, 1, 0);
-					if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
-						serwrite_uint16(next_target.S);
-					break;
-				case 'P':
-					next_target.P = decfloat_to_int(&read_digit, 1, 0);
-					if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
-						serwrite_uint16(next_target.P);
-					break;
-				case 'T':
-					next_target.T = read_digit.mantissa;
-					if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
-						serwrite_uint8(next_target.T);
-					break;
-				case 'N':
-					next_target.N = decfloat_to_int(&read_digit, 1, 0);
-					if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
-						serwrite_uint32(next_target.N);
-					break;
-				case '*':
-					next_target.checksum_read = decfloat_to_int(&read_digit, 1, 0);
-					if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
-						serwrite_uint8(next_target.checksum_read);
-					break;
-			}
-			// reset for next field
-			last_field = 0;
-			read_digit.sign = read_digit.mantissa = read_digit.exponent = 0;
-		}
-	}
+	cc = (c & 0x80) ? CC_OTHER : pgm_read_byte(&char_class[c]);
 
-	// skip comments
-	if (next_target.seen_semi_comment == 0 && next_target.seen_parens_comment == 0) {
-		// new field?
-		if ((c >= 'A' && c <= 'Z') || c == '*') {
-			last_field = c;
+	// process previous field
+	// any character will start a new field, even invalid/unknown ones
+	if (last_field && (cc <= CC_LETTER || cc == CC_EOL)) {
+		w = pgm_read_byte(&char_class[last_field]);
+		if (w >= SEEN_X && w <= SEEN_E) {
+			// X, Y, Z or E, the bulk of all words, are consecutive in TARGET
+			int32_t *axis = &next_target.target.X + (w - SEEN_X);
+			int32_t *fraction = &fractions_next[w - SEEN_X];
+
+			// G92 sets positions, so its words start from their own fraction too
+			if ((next_target.option_relative == 0
+				#ifndef	E_ABSOLUTE
+				&& w != SEEN_E
+				#endif
+				) || next_target.G == 92)
+				*fraction = 0;
+			*axis = decfloat_to_length(&read_digit, w - SEEN_X, fraction);
 			if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
-				serial_writechar(c);
+				serwrite_int32(*axis);
 		}
-
-		// process character
-		switch (c) {
-			// each currently known command is either G or M, so preserve previous G/M unless a new one has appeared
-			// FIXME: same for T command
+		else switch (last_field) {
 			case 'G':
-				next_target.seen_G = 1;
-				next_target.seen_M = 0;
-				next_target.M = 0;
+				next_target.G = read_digit.mantissa;
+				if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
+					serwrite_uint8(next_target.G);
 				break;
 			case 'M':
-				next_target.seen_M = 1;
-				next_target.seen_G = 0;
-				next_target.G = 0;
-				break;
-			case 'X':
-				next_target.seen_X = 1;
-				break;
-			case 'Y':
-				next_target.seen_Y = 1;
-				break;
-			case 'Z':
-				next_target.seen_Z = 1;
-				break;
-			case 'E':
-				next_target.seen_E = 1;
+				next_target.M = read_digit.mantissa;
+				if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
+					serwrite_uint8(next_target.M);
 				break;
 			case 'F':
-				next_target.seen_F = 1;
+				// just use raw integer, we need move distance and n_steps to convert it to a useful value, so wait until we have those to convert it
+				if (next_target.option_inches)
+					next_target.target.F = decfloat_to_int(&read_digit, 25400, 1);
+				else
+					next_target.target.F = decfloat_to_int(&read_digit, 1, 0);
+				if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
+					serwrite_uint32(next_target.target.F);
 				break;
 			case 'S':
-				next_target.seen_S = 1;
+				// if this is temperature, multiply by 4 to convert to quarter-degree units
+				// cosmetically this should be done in the temperature section,
+				// but it takes less code, less memory and loses no precision if we do it here instead
+				if ((next_target.M == 104) || (next_target.M == 109) || (next_target.M == 139) || (next_target.M == 140))
+					next_target.S = decfloat_to_int(&read_digit, 4, 0);
+				// if this is heater PID stuff, multiply by PID_SCALE because we divide by PID_SCALE later on
+				else if (((next_target.M >= 130) && (next_target.M <= 132)) || (next_target.M == 137) || (next_target.M == 138))
+					next_target.S = decfloat_to_int(&read_digit, PID_SCALE, 0);
+				else
+					next_target.S = decfloat_to_int(&read_digit, 1, 0);
+				if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
+					serwrite_uint16(next_target.S);
 				break;
 			case 'P':
-				next_target.seen_P = 1;
+				next_target.P = decfloat_to_int(&read_digit, 1, 0);
+				if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
+					serwrite_uint16(next_target.P);
 				break;
+			#ifdef ARC_SUPPORT
+			case 'I':
+				next_target.I = decfloat_to_length(&read_digit, LENGTH_UM, NULL);
+				if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
+					serwrite_int32(next_target.I);
+				break;
+			case 'J':
+				next_target.J = decfloat_to_length(&read_digit, LENGTH_UM, NULL);
+				if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
+					serwrite_int32(next_target.J);
+				break;
+			case 'R':
+				next_target.R = decfloat_to_length(&read_digit, LENGTH_UM, NULL);
+				if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
+					serwrite_int32(next_target.R);
+				break;
+			#endif
 			case 'T':
-				next_target.seen_T = 1;
+				next_target.T = read_digit.mantissa;
+				if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
+					serwrite_uint8(next_target.T);
 				break;
 			case 'N':
-				next_target.seen_N = 1;
+				next_target.N = decfloat_to_int(&read_digit, 1, 0);
+				if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
+					serwrite_uint32(next_target.N);
 				break;
 			case '*':
-				next_target.seen_checksum = 1;
+				next_target.checksum_read = decfloat_to_int(&read_digit, 1, 0);
+				if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
+					serwrite_uint8(next_target.checksum_read);
+				break;
+		}
+		// reset for next field
+		last_field = 0;
+		read_digit.sign = read_digit.mantissa = read_digit.exponent = 0;
+	}
+
+	// skip comments
+	if (next_target.seen_semi_comment == 0 && next_target.seen_parens_comment == 0) {
+		if (cc == CC_DIGIT) {
+			if (read_digit.exponent < DECFLOAT_EXP_MAX &&
+					read_digit.mantissa < mantissa_max)
+			{
+				// this is simply mantissa = (mantissa * 10) + atoi(c) in different clothes
+				read_digit.mantissa = (read_digit.mantissa << 3) + (read_digit.mantissa << 1) + (c - '0');
+				if (read_digit.exponent)
+					read_digit.exponent++;
+			}
+		}
+		else if (cc < CC_LETTER) {
+			// new field of a known word, set its seen_* flag. flags is little endian.
+			last_field = c;
+			if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
+				serial_writechar(c);
+			((uint8_t *) &next_target.flags)[cc >> 3] |= 1 << (cc & 7);
+
+			if ((cc >= SEEN_X && cc <= SEEN_E) || cc >= SEEN_I)
+				mantissa_max = DECFLOAT_MANT_LENGTH_MAX;
+			else
+				mantissa_max = next_target.option_inches ? DECFLOAT_MANT_IN_MAX : DECFLOAT_MANT_MM_MAX;
+
+			// each currently known command is either G or M, so preserve previous G/M unless a new one has appeared
+			// FIXME: same for T command
+			if (cc == SEEN_G) {
+				next_target.seen_M = 0;
+				next_target.M = 0;
+			}
+			else if (cc == SEEN_M) {
+				next_target.seen_G = 0;
+				next_target.G = 0;
+			}
+		}
+		else switch (cc) {
+			case CC_LETTER:
+				last_field = c;
+				if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
+					serial_writechar(c);
+				#ifdef	DEBUG
+					// invalid
+					serial_writechar('?');
+					serial_writechar(c);
+					serial_writechar('?');
+				#endif
 				break;
 
 			// comments
-			case ';':
+			case CC_SEMI:
 				next_target.seen_semi_comment = 1;
 				break;
-			case '(':
+			case CC_PARENS:
 				next_target.seen_parens_comment = 1;
 				break;
 
 			// now for some numeracy
-			case '-':
+			case CC_MINUS:
 				read_digit.sign = 1;
 				// force sign to be at start of number, so 1-2 = -2 instead of -12
 				read_digit.exponent = 0;
 				read_digit.mantissa = 0;
 				break;
-			case '.':
+			case CC_DOT:
 				if (read_digit.exponent == 0)
 					read_digit.exponent = 1;
 				break;
-			#ifdef	DEBUG
-			case ' ':
-			case '\t':
-			case 10:
-			case 13:
+			case CC_EOL:
+			case CC_BLANK:
 				// ignore
 				break;
-			#endif
 
 			default:
-				// can't do ranges in switch..case, so process actual digits here.
-				if (c >= '0' && c <= '9') {
-					if (read_digit.exponent < DECFLOAT_EXP_MAX &&
-							((next_target.option_inches == 0 &&
-							read_digit.mantissa < DECFLOAT_MANT_MM_MAX) ||
-							(next_target.option_inches &&
-							read_digit.mantissa < DECFLOAT_MANT_IN_MAX)))
-					{
-						// this is simply mantissa = (mantissa * 10) + atoi(c) in different clothes
-						read_digit.mantissa = (read_digit.mantissa << 3) + (read_digit.mantissa << 1) + (c - '0');
-						if (read_digit.exponent)
-							read_digit.exponent++;
-					}
-				}
 				#ifdef	DEBUG
-				else {
 					// invalid
 					serial_writechar('?');
 					serial_writechar(c);
 					serial_writechar('?');
-				}
 				#endif
+				break;
 		}
 	} else if ( next_target.seen_parens_comment == 1 && c == ')')
 		next_target.seen_parens_comment = 0; // recognize stuff after a (comment)
@@ -330,7 +460,7 @@ void gcode_parse_char(uint8_t c) {
 		next_target.checksum_calculated = crc(next_target.checksum_calculated, c);
 
 	// end of line
-	if ((c == 10) || (c == 13)) {
+	if (cc == CC_EOL) {
 		if (DEBUG_ECHO && (debug_flags & DEBUG_ECHO))
 			serial_writechar(c);
 
@@ -350,7 +480,14 @@ void gcode_parse_char(uint8_t c) {
 				#endif
 				) {
 				// process
+				memcpy(fractions, fractions_next, sizeof(fractions));
 				serial_writestr_P(PSTR("ok "));
+				#ifdef	OK_CREDITS
+					// room for more moves and more G-code, for hosts sending ahead.
+					// Sent ahead of the output of the command, so it's counted before
+					// the move of this line is queued.
+					sersendf_P(PSTR("Q:%u R:%u "), queue_free(), serial_rxfree());
+				#endif
 				process_gcode_command();
 				serial_writechar('\n');
 
@@ -375,7 +512,13 @@ void gcode_parse_char(uint8_t c) {
 			next_target.seen_M = next_target.seen_checksum = next_target.seen_semi_comment = \
 			next_target.seen_parens_comment = next_target.checksum_read = \
 			next_target.checksum_calculated = 0;
+		#ifdef ARC_SUPPORT
+			next_target.seen_I = next_target.seen_J = next_target.seen_R = 0;
+			// arc centre defaults to the start point
+			next_target.I = next_target.J = 0;
+		#endif
 		// last_field and read_digit are reset above already
+		memcpy(fractions_next, fractions, sizeof(fractions));
 
 		// assume a G1 by default
 		next_target.seen_G = 1;
@@ -5,6 +5,25 @@
 
 #include	"dda.h"
 
+/*
+	Switch user friendly values to coding friendly values
+
+	This also affects the possible build volume. We have +/- 2^31 numbers available and as we internally measure position in steps and use a precision factor of 1000, this translates into a possible range of
+
+		2^31 mm / STEPS_PER_MM_x / 1000
+
+	for each axis. For a M6 threaded rod driven machine and 1/16 microstepping this evaluates to
+
+		2^31 mm / 200 / 16 / 1000 = 671 mm,
+
+	which is about the worst case we have. All other machines have a bigger build volume.
+*/
+
+#define	STEPS_PER_M_X			((uint32_t) ((STEPS_PER_MM_X * 1000.0) + 0.5))
+#define	STEPS_PER_M_Y			((uint32_t) ((STEPS_PER_MM_Y * 1000.0) + 0.5))
+#define	STEPS_PER_M_Z			((uint32_t) ((STEPS_PER_MM_Z * 1000.0) + 0.5))
+#define	STEPS_PER_M_E			((uint32_t) ((STEPS_PER_MM_E * 1000.0) + 0.5))
+
 // wether to insist on N line numbers
 // if not defined, N's are completely ignored
 //#define	REQUIRE_LINENUMBER
@@ -24,6 +43,7 @@ typedef struct {
 /// this holds all the possible data from a received command
 typedef struct {
 	union {
+		/// the parser sets seen_* flags by their bit number in flags, see SEEN_G and friends in gcode_parse.c, so keep the order
 		struct {
 			uint8_t					seen_G	:1;
 			uint8_t					seen_M	:1;
@@ -42,8 +62,14 @@ typedef struct {
 			uint8_t					seen_parens_comment	:1; ///< seen an open parenthesis
 			uint8_t					option_relative			:1; ///< relative or absolute coordinates?
 			uint8_t					option_inches				:1; ///< inches or millimeters?
+
+			#ifdef ARC_SUPPORT
+			uint8_t					seen_I	:1;
+			uint8_t					seen_J	:1;
+			uint8_t					seen_R	:1;
+			#endif
 		};
-		uint16_t				flags;
+		uint32_t				flags;
 	};
 
 	uint8_t						G;				///< G command number
@@ -55,6 +81,12 @@ typedef struct {
 
 	uint8_t						T;				///< T word (tool index)
 
+	#ifdef ARC_SUPPORT
+	int32_t						I;				///< arc centre, X distance from start [um]
+	int32_t						J;				///< arc centre, Y distance from start [um]
+	int32_t						R;				///< arc radius [um]
+	#endif
+
 	uint32_t					N;				///< line number
 	uint32_t					N_expected;	///< expected line number
 
@@ -71,4 +103,7 @@ void gcode_parse_char(uint8_t c);
 // uses the global variable next_target.N
 void request_resend(void);
 
+/// forget the fractions of a step carried for X, Y and Z
+void gcode_clear_fractions(void);
+
 #endif	/* _GCODE_PARSE_H */
@@ -23,6 +23,9 @@
 #include	"clock.h"
 #include	"config.h"
 #include	"home.h"
+#include	"arc.h"
+#include	"profile.h"
+#include	"gcode_binary.h"
 
 /// the current tool
 uint8_t tool;
@@ -37,30 +40,6 @@ uint8_t next_tool;
 	this is where we construct a move without a gcode command, useful for gcodes which require multiple moves eg; homing
 */
 
-/// move to X = 0
-static void zero_x(void) {
-	TARGET t = startpoint;
-	t.X = 0;
-	t.F = SEARCH_FEEDRATE_X;
-	enqueue(&t);
-}
-
-/// move to Y = 0
-static void zero_y(void) {
-	TARGET t = startpoint;
-	t.Y = 0;
-	t.F = SEARCH_FEEDRATE_Y;
-	enqueue(&t);
-}
-
-/// move to Z = 0
-static void zero_z(void) {
-	TARGET t = startpoint;
-	t.Z = 0;
-	t.F = SEARCH_FEEDRATE_Z;
-	enqueue(&t);
-}
-
 #if E_STARTSTOP_STEPS > 0
 /// move E by a certain amount at a certain speed
 static void SpecialMoveE(int32_t e, uint32_t f) {
@@ -71,6 +50,53 @@ static void SpecialMoveE(int32_t e, uint32_t f) {
 }
 #endif /* E_STARTSTOP_STEPS > 0 */
 
+/*! keep a target within the axis limits X_MIN, X_MAX, Y_MIN, etc.
+	\param *t target to clip [steps]
+	\return 255 if anything was clipped, 0 otherwise
+*/
+uint8_t clip_to_axis_limits(TARGET *t) {
+	uint8_t	clipped = 0;
+
+	#ifdef	X_MIN
+		if (t->X < (X_MIN * STEPS_PER_MM_X)) {
+			t->X = X_MIN * STEPS_PER_MM_X;
+			clipped = 255;
+		}
+	#endif
+	#ifdef	X_MAX
+		if (t->X > (X_MAX * STEPS_PER_MM_X)) {
+			t->X = X_MAX * STEPS_PER_MM_X;
+			clipped = 255;
+		}
+	#endif
+	#ifdef	Y_MIN
+		if (t->Y < (Y_MIN * STEPS_PER_MM_Y)) {
+			t->Y = Y_MIN * STEPS_PER_MM_Y;
+			clipped = 255;
+		}
+	#endif
+	#ifdef	Y_MAX
+		if (t->Y > (Y_MAX * STEPS_PER_MM_Y)) {
+			t->Y = Y_MAX * STEPS_PER_MM_Y;
+			clipped = 255;
+		}
+	#endif
+	#ifdef	Z_MIN
+		if (t->Z < (Z_MIN * STEPS_PER_MM_Z)) {
+			t->Z = Z_MIN * STEPS_PER_MM_Z;
+			clipped = 255;
+		}
+	#endif
+	#ifdef	Z_MAX
+		if (t->Z > (Z_MAX * STEPS_PER_MM_Z)) {
+			t->Z = Z_MAX * STEPS_PER_MM_Z;
+			clipped = 255;
+		}
+	#endif
+
+	return clipped;
+}
+
 /************************************************************************//**
 
   \brief Processes command stored in global \ref next_target.
@@ -83,6 +109,9 @@ static void SpecialMoveE(int32_t e, uint32_t f) {
 
 void process_gcode_command() {
 	uint32_t	backup_f;
+	#ifdef ARC_SUPPORT
+		uint8_t		clipped;
+	#endif
 
 	// convert relative to absolute
 	if (next_target.option_relative) {
@@ -100,29 +129,10 @@ void process_gcode_command() {
 	// moved to dda.c, end of dda_create() and dda_queue.c, next_move()
 
 	// implement axis limits
-	#ifdef	X_MIN
-		if (next_target.target.X < (X_MIN * STEPS_PER_MM_X))
-			next_target.target.X = X_MIN * STEPS_PER_MM_X;
-	#endif
-	#ifdef	X_MAX
-		if (next_target.target.X > (X_MAX * STEPS_PER_MM_X))
-			next_target.target.X = X_MAX * STEPS_PER_MM_X;
-	#endif
-	#ifdef	Y_MIN
-		if (next_target.target.Y < (Y_MIN * STEPS_PER_MM_Y))
-			next_target.target.Y = Y_MIN * STEPS_PER_MM_Y;
-	#endif
-	#ifdef	Y_MAX
-		if (next_target.target.Y > (Y_MAX * STEPS_PER_MM_Y))
-			next_target.target.Y = Y_MAX * STEPS_PER_MM_Y;
-	#endif
-	#ifdef	Z_MIN
-		if (next_target.target.Z < (Z_MIN * STEPS_PER_MM_Z))
-			next_target.target.Z = Z_MIN * STEPS_PER_MM_Z;
-	#endif
-	#ifdef	Z_MAX
-		if (next_target.target.Z > (Z_MAX * STEPS_PER_MM_Z))
-			next_target.target.Z = Z_MAX * STEPS_PER_MM_Z;
+	#ifdef ARC_SUPPORT
+		clipped = clip_to_axis_limits(&next_target.target);
+	#else
+		clip_to_axis_limits(&next_target.target);
 	#endif
 
 
@@ -176,11 +186,41 @@ void process_gcode_command() {
 				enqueue(&next_target.target);
 				break;
 
+			#ifdef ARC_SUPPORT
+				//	G2 - Arc Clockwise
+			case 2:
+				//	G3 - Arc Counter-clockwise
+			case 3:
+				//? ==== G2, G3: Controlled arc move ====
+				//?
+				//? Example: G2 X90.6 Y13.8 I5 J10 E22.4
+				//?
+				//? Go along an arc in the XY plane from the current point to (90.6, 13.8), clockwise for G2, counter-clockwise for G3. I and J give the centre of the arc relative to the current point, here 5 mm in X and 10 mm in Y. Omitting X and Y, or giving the current point, makes a full circle. Z and E change linearly along the arc.
+				//?
+				//? Example: G3 X90.6 Y13.8 R20
+				//?
+				//? Instead of the centre, the radius can be given. A negative radius selects the longer of the two possible arcs.
+				//?
+				//? The arc is split into linear moves of ARC_SEGMENT_LENGTH by the firmware. The next command is read only after all of them are queued.
+				//?
+				//? Arcs ending outside the axis limits are refused with an error. Parts of an arc beyond them are cut off like any other move.
+				if (clipped) {
+					sersendf_P(PSTR("E: arc ends outside the axis limits"));
+					// newline is sent from gcode_parse after we return
+					return;
+				}
+				if (next_target.seen_R)
+					arc_start_radius(&next_target.target, next_target.R, next_target.G == 2);
+				else
+					arc_start(&next_target.target, next_target.I, next_target.J, next_target.G == 2);
+				break;
+			#else
 				//	G2 - Arc Clockwise
 				// unimplemented
 
 				//	G3 - Arc Counter-clockwise
 				// unimplemented
+			#endif
 
 				//	G4 - Dwell
 			case 4:
@@ -259,6 +299,7 @@ void process_gcode_command() {
 					next_target.target.X = 0;
 					next_target.target.Y = 0;
 					next_target.target.Z = 0;
+					gcode_clear_fractions();
 				}
 				backup_f = next_target.target.F;
 				next_target.target.F = 99999;		// let the software clip this to the maximum allowed rate
@@ -320,7 +361,9 @@ void process_gcode_command() {
 					startpoint.X = current_position.X = next_target.target.X =
 					startpoint.Y = current_position.Y = next_target.target.Y =
 					startpoint.Z = current_position.Z = next_target.target.Z = 0;
+					gcode_clear_fractions();
 				}
+				dda_new_startpoint();
 				break;
 
 			// G161 - Home negative
@@ -334,6 +377,8 @@ void process_gcode_command() {
 					home_y_negative( next_target.target.F);
 				if (next_target.seen_Z)
 					home_z_negative( next_target.target.F);
+				gcode_clear_fractions();
+				dda_new_startpoint();
 				break;
 			// G162 - Home positive
 			case 162:
@@ -346,6 +391,8 @@ void process_gcode_command() {
 					home_y_positive( next_target.target.F);
 				if (next_target.seen_Z)
 					home_z_positive( next_target.target.F);
+				gcode_clear_fractions();
+				dda_new_startpoint();
 				break;
 
 				// unknown gcode: spit an error
@@ -647,6 +694,51 @@ void process_gcode_command() {
 				//? Undocumented.
 				heater_save_settings();
 				break;
+			#ifdef	HEATER_FEEDFORWARD
+			// M137- heater feed-forward factor for extrusion
+			case 137:
+				//? ==== M137: heater feed-forward factor for extrusion ====
+				//?
+				//? Example: M137 P0 S8.5
+				//?
+				//? Add 8.5 PWM counts to the output of heater 0 for every 1000 E steps per second currently extruded, to make up for the heat carried away by the filament before the temperature drops. M134 saves it to eeprom.
+				//?
+				//? This command is only available if HEATER_FEEDFORWARD is defined.
+				if (next_target.seen_S)
+					pid_set_ff_e(next_target.P, next_target.S);
+				break;
+			// M138- heater feed-forward factor for target temperature
+			case 138:
+				//? ==== M138: heater feed-forward factor for target temperature ====
+				//?
+				//? Example: M138 P0 S0.6
+				//?
+				//? Add 0.6 PWM counts to the output of heater 0 for every degree of its target temperature, roughly the power needed to hold it, so the I term has less to make up for. M134 saves it to eeprom.
+				//?
+				//? This command is only available if HEATER_FEEDFORWARD is defined.
+				if (next_target.seen_S)
+					pid_set_ff_t(next_target.P, next_target.S);
+				break;
+			#endif
+			#ifdef	PID_AUTOTUNE
+			// M139- PID autotune
+			case 139:
+				//? ==== M139: heater PID autotune ====
+				//?
+				//? Example: M139 P0 S200
+				//?
+				//? Tune the PID factors of the heater of temp sensor 0 at 200<sup>o</sup>C. Waits for all moves to complete, starts the tune and returns. The tune switches the heater full on below the target and off above it until the temperature oscillates steadily, which takes some minutes. From this, the ultimate gain Ku and period Tu, Ziegler-Nichols and Tyreus-Luyben factors are reported, the Ziegler-Nichols ones are put into use. The heater is off afterwards. M134 saves the new factors to eeprom.
+				//?
+				//? The report comes whenever the tune ends, as lines starting with Ku:, TL and ZN. Other commands work meanwhile, M105 shows the temperature. Another target temperature for the sensor, e.g. from M104, stops the tune, leaving the factors as they were, and reports !! autotune of heater 0 stopped. M112 stops everything as usual.
+				//?
+				//? This command is only available if PID_AUTOTUNE is defined.
+				if (next_target.seen_S) {
+					queue_wait();
+					power_on();
+					heater_autotune(next_target.P, next_target.S);
+				}
+				break;
+			#endif
 			// M135- set heater output
 			case 135:
 				//? ==== M135: set heater output ====
@@ -754,9 +846,17 @@ void process_gcode_command() {
 				//? ==== M250: return current position, end position, queue ====
 				//? Undocumented
 				//? This command is only available in DEBUG builds.
-				sersendf_P(PSTR("{X:%ld,Y:%ld,Z:%ld,E:%ld,F:%lu,c:%lu}\t{X:%ld,Y:%ld,Z:%ld,E:%ld,F:%lu,c:%lu}\t"), current_position.X, current_position.Y, current_position.Z, current_position.E, current_position.F, movebuffer[mb_tail].c, movebuffer[mb_tail].endpoint.X, movebuffer[mb_tail].endpoint.Y, movebuffer[mb_tail].endpoint.Z, movebuffer[mb_tail].endpoint.E, movebuffer[mb_tail].endpoint.F,
+				sersendf_P(PSTR("{X:%ld,Y:%ld,Z:%ld,E:%ld,F:%lu,c:%lu}\t{X:%ld,Y:%ld,Z:%ld,E:%ld,F:%lu,c:%lu}\t"), current_position.X, current_position.Y, current_position.Z, current_position.E, current_position.F,
+					#ifdef ACCELERATION_RAMPING
+						move_state.c,
+					#else
+						movebuffer[mb_tail].c,
+					#endif
+					move_state.endpoint.X, move_state.endpoint.Y, move_state.endpoint.Z, move_state.endpoint.E, movebuffer[mb_tail].F,
 					#ifdef ACCELERATION_REPRAP
 						movebuffer[mb_tail].end_c
+					#elif defined ACCELERATION_RAMPING
+						movebuffer[mb_tail].c_min
 					#else
 						movebuffer[mb_tail].c
 					#endif
@@ -773,7 +873,7 @@ void process_gcode_command() {
 				if (next_target.seen_P == 0)
 					next_target.P = 1;
 				for (; next_target.P; next_target.P--) {
-					serwrite_hex8(*(volatile uint8_t *)(next_target.S));
+					serwrite_hex8(*(volatile uint8_t *)(uintptr_t)(next_target.S));
 					next_target.S++;
 				}
 				// newline is sent from gcode_parse after we return
@@ -784,11 +884,44 @@ void process_gcode_command() {
 				//? ==== M254: write arbitrary memory location ====
 				//? Undocumented
 				//? This command is only available in DEBUG builds.
-				sersendf_P(PSTR("%x:%x->%x"), next_target.S, *(volatile uint8_t *)(next_target.S), next_target.P);
-				(*(volatile uint8_t *)(next_target.S)) = next_target.P;
+				sersendf_P(PSTR("%x:%x->%x"), next_target.S, *(volatile uint8_t *)(uintptr_t)(next_target.S), next_target.P);
+				(*(volatile uint8_t *)(uintptr_t)(next_target.S)) = next_target.P;
 				// newline is sent from gcode_parse after we return
 				break;
 			#endif /* DEBUG */
+
+			#ifdef	STEP_PROFILE
+			// M251- report step interrupt profile
+			case 251:
+				//? ==== M251: report step interrupt profile ====
+				//?
+				//? Example: M251 S1
+				//?
+				//? Report the run time of the step interrupt and the functions it calls, one line each: number of runs, minimum, maximum and mean run time in CPU clock ticks, and a histogram of run times. Histogram bin i counts runs shorter than 64 * 2^i ticks, the last bin all longer ones. The step interrupt line also gives the highest step rate the CPU could sustain. The last line is the analog interrupt, its number of runs over the time since the statistics were cleared gives its rate, see ADC_TIMER_TRIGGER. With S1, statistics are cleared after reporting.
+				//?
+				//? This command is only available if STEP_PROFILE is defined.
+				profile_report();
+				if (next_target.seen_S && next_target.S)
+					profile_reset();
+				// newline is sent from gcode_parse after we return
+				break;
+			#endif
+
+			#ifdef	BINARY_GCODE
+			// M252- switch to binary frames
+			case 252:
+				//? ==== M252: Switch to binary transport ====
+				//?
+				//? Example: M252
+				//?
+				//? After the ok to this command, moves are expected as binary frames instead of G-code, already scaled to steps by the host. This takes a third to half the bytes of G-code on the serial line and no parsing. A frame can ask to switch back to G-code. See gcode_binary.c for the frame format and gcode2bin.py for a host side encoder.
+				//?
+				//? Frames are queued as they are: axis limits (X_MIN, X_MAX and so on) are not applied, and fractions of a step left over by rounding are not carried to the next move as they are for G-code. Keeping moves within the limits and rounding without drift are up to the host.
+				//?
+				//? This command is only available if BINARY_GCODE is defined.
+				binary_start();
+				break;
+			#endif
 				// unknown mcode: spit an error
 			default:
 				sersendf_P(PSTR("E: Bad M-code %d"), next_target.M);
@@ -8,6 +8,9 @@ extern uint8_t tool;
 // the tool to be changed when we get an M6
 extern uint8_t next_tool;
 
+// keep a target within X_MIN, X_MAX etc., returns 255 if it had to
+uint8_t clip_to_axis_limits(TARGET *t);
+
 // when we have a whole line, feed it to this
 void process_gcode_command(void);
 
@@ -12,6 +12,12 @@
 #include	"debug.h"
 #include	"temp.h"
 #include	"crc.h"
+#ifdef	PID_AUTOTUNE
+	#include	"dda_util.h"
+#endif
+#ifdef	HEATER_FEEDFORWARD
+	#include	"dda.h"
+#endif
 
 #ifndef	EXTRUDER
 	#include	"sersendf.h"
@@ -43,6 +49,8 @@ static const heater_definition_t heaters[NUM_HEATERS] =
 
 	At every sample, we calculate \f$OUT = k_P (S - T) + k_I \int (S - T) + k_D \frac{dT}{dt}\f$ where S is setpoint and T is temperature.
 
+	With HEATER_FEEDFORWARD, \f$k_E E + k_T S\f$ is added, E being the rate of extrusion. This gives the power for heating the filament pushed through and for holding the temperature up front, instead of waiting for the temperature to drop.
+
 	The three factors kP, kI, kD are chosen to give the desired behaviour given the dynamics of the system.
 
 	See http://www.eetimes.com/design/embedded/4211211/PID-without-a-PhD for the full story
@@ -52,6 +60,10 @@ struct {
 	int32_t						i_factor; ///< scaled I factor
 	int32_t						d_factor; ///< scaled D factor
 	int16_t						i_limit;  ///< scaled I limit, such that \f$-i_{limit} < i_{factor} < i_{limit}\f$
+	#ifdef	HEATER_FEEDFORWARD
+	int32_t						ff_e_factor; ///< scaled feed-forward factor, PWM per 1000 E steps per second
+	int32_t						ff_t_factor; ///< scaled feed-forward factor, PWM per degree of target temperature
+	#endif
 } heaters_pid[NUM_HEATERS];
 
 /// \brief this struct holds the runtime heater data- PID integrator history, temperature history, sanity checker
@@ -84,11 +96,40 @@ typedef struct {
 	int32_t		EE_i_factor;
 	int32_t		EE_d_factor;
 	int16_t		EE_i_limit;
+	#ifdef	HEATER_FEEDFORWARD
+	int32_t		EE_ff_e_factor;
+	int32_t		EE_ff_t_factor;
+	#endif
 	uint16_t	crc; ///< crc so we can use defaults if eeprom data is invalid
 } EE_factor;
 
 EE_factor EEMEM EE_factors[NUM_HEATERS];
 
+#ifdef	PID_AUTOTUNE
+/// full oscillations averaged by the autotune, after the heat up and one more
+#define		AUTOTUNE_CYCLES			5
+/// the autotune relay switches this far above and below the target temperature, in quarter degrees
+#define		AUTOTUNE_HYSTERESIS	2
+/// ultimate gain for a relay switching between 0 and 255 and a peak to peak swing of one quarter degree, \f$\frac{4 d}{\pi a}\f$ with d = 127.5 and a = 0.5, scaled by PID_SCALE
+#define		AUTOTUNE_KU					((uint32_t) (4. * 255. / 3.14159265 * PID_SCALE))
+
+/**
+	\var autotune
+	\brief state of the relay autotune, see heater_autotune()
+*/
+static struct {
+	temp_sensor_t			sensor;			///< sensor of the heater being tuned, NUM_TEMP_SENSORS if none
+	uint16_t					target;			///< temperature tuned at, another target stops the tune
+	uint8_t						heating;		///< relay state
+	uint8_t						cycles;			///< times the relay switched on so far
+	uint16_t					ticks;			///< heater ticks since the relay switched on
+	uint16_t					high;				///< highest temperature since the relay switched on
+	uint16_t					low;				///< lowest temperature since the relay switched on
+	uint32_t					period;			///< sum of oscillation periods, in heater ticks
+	uint32_t					swing;			///< sum of peak to peak temperature swings
+} autotune = { NUM_TEMP_SENSORS };
+#endif
+
 /// \brief initialise heater subsystem
 /// Set directions, initialise PWM timers, read PID factors from eeprom, etc
 void heater_init() {
@@ -97,7 +138,9 @@ void heater_init() {
 	for (i = 0; i < NUM_HEATERS; i++) {
 		if (heaters[i].heater_pwm) {
 			*heaters[i].heater_pwm = 0;
+			#ifndef	SIMULATOR
 			// this is somewhat ugly too, but switch() won't accept pointers for reasons unknown
+			// simulated registers have no constant addresses, and no timers to set up
 			switch((uint16_t) heaters[i].heater_pwm) {
 				case (uint16_t) &OCR0A:
 					TCCR0A |= MASK(COM0A1);
@@ -145,6 +188,7 @@ void heater_init() {
 					break;
 				#endif
 			}
+			#endif	/* SIMULATOR */
 		}
 
 		#ifdef	HEATER_SANITY_CHECK
@@ -158,13 +202,21 @@ void heater_init() {
 			heaters_pid[i].i_factor = eeprom_read_dword((uint32_t *) &EE_factors[i].EE_i_factor);
 			heaters_pid[i].d_factor = eeprom_read_dword((uint32_t *) &EE_factors[i].EE_d_factor);
 			heaters_pid[i].i_limit = eeprom_read_word((uint16_t *) &EE_factors[i].EE_i_limit);
+			#ifdef	HEATER_FEEDFORWARD
+				heaters_pid[i].ff_e_factor = eeprom_read_dword((uint32_t *) &EE_factors[i].EE_ff_e_factor);
+				heaters_pid[i].ff_t_factor = eeprom_read_dword((uint32_t *) &EE_factors[i].EE_ff_t_factor);
+			#endif
 
 // 			if ((heaters_pid[i].p_factor == 0) && (heaters_pid[i].i_factor == 0) && (heaters_pid[i].d_factor == 0) && (heaters_pid[i].i_limit == 0)) {
-			if (crc_block(&heaters_pid[i].p_factor, 14) != eeprom_read_word((uint16_t *) &EE_factors[i].crc)) {
+			if (crc_block(&heaters_pid[i].p_factor, sizeof(heaters_pid[i])) != eeprom_read_word((uint16_t *) &EE_factors[i].crc)) {
 				heaters_pid[i].p_factor = DEFAULT_P;
 				heaters_pid[i].i_factor = DEFAULT_I;
 				heaters_pid[i].d_factor = DEFAULT_D;
 				heaters_pid[i].i_limit = DEFAULT_I_LIMIT;
+				#ifdef	HEATER_FEEDFORWARD
+					heaters_pid[i].ff_e_factor = 0;
+					heaters_pid[i].ff_t_factor = 0;
+				#endif
 			}
 		#endif /* BANG_BANG */
 	}
@@ -179,11 +231,156 @@ void heater_save_settings() {
 			eeprom_write_dword((uint32_t *) &EE_factors[i].EE_i_factor, heaters_pid[i].i_factor);
 			eeprom_write_dword((uint32_t *) &EE_factors[i].EE_d_factor, heaters_pid[i].d_factor);
 			eeprom_write_word((uint16_t *) &EE_factors[i].EE_i_limit, heaters_pid[i].i_limit);
-			eeprom_write_word((uint16_t *) &EE_factors[i].crc, crc_block(&heaters_pid[i].p_factor, 14));
+			#ifdef	HEATER_FEEDFORWARD
+				eeprom_write_dword((uint32_t *) &EE_factors[i].EE_ff_e_factor, heaters_pid[i].ff_e_factor);
+				eeprom_write_dword((uint32_t *) &EE_factors[i].EE_ff_t_factor, heaters_pid[i].ff_t_factor);
+			#endif
+			eeprom_write_word((uint16_t *) &EE_factors[i].crc, crc_block(&heaters_pid[i].p_factor, sizeof(heaters_pid[i])));
 		}
 	#endif /* BANG_BANG */
 }
 
+#ifdef	PID_AUTOTUNE
+/** \brief set PID factors from gain and times
+	\param h heater to set factors for
+	\param p proportional gain, scaled by PID_SCALE
+	\param ti integral time in heater ticks
+	\param td derivative time in heater ticks
+
+	In heater_tick() terms, I sums the error once per tick and D looks
+	TH_COUNT - 1 ticks back, so \f$i = p / T_I\f$ and
+	\f$d = p T_D / (TH\_COUNT - 1)\f$. The I limit lets the integral reach
+	full output, as far as the 16 bit integrator allows.
+*/
+static void autotune_set(heater_t h, uint32_t p, uint32_t ti, uint32_t td) {
+	uint32_t	i = (p + ti / 2) / ti;
+
+	if (i == 0)
+		i = 1;
+	heaters_pid[h].p_factor = p;
+	heaters_pid[h].i_factor = i;
+	heaters_pid[h].d_factor = p / (TH_COUNT - 1) * td;
+	heaters_pid[h].i_limit = (255 * PID_SCALE / i > 32767) ? 32767 : 255 * PID_SCALE / i;
+	heaters_runtime[h].heater_i = 0;
+	sersendf_P(PSTR(" P:%lu I:%lu D:%lu Ilim:%u\n"), heaters_pid[h].p_factor, heaters_pid[h].i_factor, heaters_pid[h].d_factor, heaters_pid[h].i_limit);
+}
+
+/** \brief work out PID factors from the measured oscillation
+	\param h heater being tuned
+
+	With ultimate gain Ku and period Tu, Tyreus-Luyben gives
+	\f$K_P = K_u / 2.2, T_I = 2.2 T_u, T_D = T_u / 6.3\f$, Ziegler-Nichols
+	\f$K_P = 0.6 K_u, T_I = T_u / 2, T_D = T_u / 8\f$. Both are reported.
+	Ziegler-Nichols factors are put into use, as with the long integral time
+	of Tyreus-Luyben the integrator usually can't hold a hot end at
+	temperature.
+*/
+static void autotune_done(heater_t h) {
+	uint16_t	tu = autotune.period / AUTOTUNE_CYCLES;
+	uint32_t	swing, ku;
+
+	// peak to peak swing times 16, less the part the hysteresis accounts for
+	swing = (autotune.swing << 4) / AUTOTUNE_CYCLES;
+	if (swing > (AUTOTUNE_HYSTERESIS << 5))
+		swing = int_sqrt(swing * swing - (uint32_t) (AUTOTUNE_HYSTERESIS << 5) * (AUTOTUNE_HYSTERESIS << 5));
+	if (swing == 0)
+		swing = 1;
+	ku = (AUTOTUNE_KU << 4) / swing;
+	sersendf_P(PSTR("Ku:%lu Tu:%u0 ms\nTL"), ku, tu);
+
+	autotune_set(h, ku * 5 / 11, (uint32_t) tu * 22 / 10, (uint32_t) tu * 10 / 63);
+	sersendf_P(PSTR("ZN"));
+	autotune_set(h, ku * 3 / 5, tu / 2, tu / 8);
+}
+
+/** \brief one heater tick of the relay autotune
+	\param h heater being tuned
+	\param current_temp the temperature that the associated temp sensor is reporting
+	\param target_temp the temperature to oscillate around
+	\return heater output
+
+	The relay switches full on below the target and off above it. The
+	oscillation it ends up in tells the ultimate gain by its swing and the
+	ultimate period by the time between switching on.
+*/
+static uint8_t autotune_tick(heater_t h, uint16_t current_temp, uint16_t target_temp) {
+	if (current_temp > autotune.high)
+		autotune.high = current_temp;
+	if (current_temp < autotune.low)
+		autotune.low = current_temp;
+	autotune.ticks++;
+
+	if (autotune.heating) {
+		if (current_temp > target_temp + AUTOTUNE_HYSTERESIS)
+			autotune.heating = 0;
+	}
+	else if (current_temp < target_temp - AUTOTUNE_HYSTERESIS) {
+		// switching on completes an oscillation, skip the heat up and the first one
+		autotune.heating = 255;
+		if (autotune.cycles >= 2) {
+			autotune.period += autotune.ticks;
+			autotune.swing += autotune.high - autotune.low;
+			if (autotune.cycles == AUTOTUNE_CYCLES + 1) {
+				autotune_done(h);
+				heater_autotune_stop();
+				return 0;
+			}
+		}
+		autotune.cycles++;
+		autotune.ticks = 0;
+		autotune.high = autotune.low = current_temp;
+	}
+
+	if (autotune.ticks == 0xFFFF) {
+		sersendf_P(PSTR("!! autotune of heater %d failed, no oscillation\n"), h);
+		heater_autotune_stop();
+		return 0;
+	}
+
+	return autotune.heating ? 255 : 0;
+}
+
+/** \brief start a relay autotune
+	\param t temp sensor of the heater to tune
+	\param temperature temperature to tune at
+
+	Sets the target temperature of the sensor and returns, the tune runs
+	from heater_tick() and turns the heater off when done, which takes some
+	minutes. Results are reported then. Setting another target temperature
+	for the sensor meanwhile stops the tune. Sensors without a heater are
+	refused, heater_tick() never runs for them.
+*/
+void heater_autotune(temp_sensor_t t, uint16_t temperature) {
+	if (temp_has_heater(t) == 0) {
+		sersendf_P(PSTR("E: no heater on temp sensor %d"), t);
+		return;
+	}
+
+	autotune.heating = 255;
+	autotune.cycles = 0;
+	autotune.ticks = 0;
+	autotune.high = 0;
+	autotune.low = 0xFFFF;
+	autotune.period = 0;
+	autotune.swing = 0;
+	autotune.sensor = t;
+	autotune.target = temperature;
+	temp_set(t, temperature);
+}
+
+/// \brief stop the autotune and turn the heater off
+void heater_autotune_stop() {
+	if (autotune.sensor < NUM_TEMP_SENSORS)
+		temp_set(autotune.sensor, 0);
+	autotune.sensor = NUM_TEMP_SENSORS;
+}
+
+/// \brief whether an autotune is running
+uint8_t heater_autotune_running() {
+	return (autotune.sensor < NUM_TEMP_SENSORS) ? 255 : 0;
+}
+#endif	/* PID_AUTOTUNE */
+
 /** \brief run heater PID algorithm
 	\param h which heater we're running the loop for
 	\param t which temp sensor this heater is attached to
@@ -202,6 +399,14 @@ void heater_tick(heater_t h, temp_sensor_t t, uint16_t current_temp, uint16_t ta
 	if (h >= NUM_HEATERS || t >= NUM_TEMP_SENSORS)
 		return;
 
+	#ifdef	PID_AUTOTUNE
+		// e.g. M104 while tuning
+		if (autotune.sensor == t && target_temp != autotune.target) {
+			sersendf_P(PSTR("!! autotune of heater %d stopped\n"), h);
+			autotune.sensor = NUM_TEMP_SENSORS;
+		}
+	#endif
+
 	if (target_temp == 0) {
 		heater_set(h, 0);
 		return;
@@ -236,6 +441,14 @@ void heater_tick(heater_t h, temp_sensor_t t, uint16_t current_temp, uint16_t ta
 			) / PID_SCALE
 		);
 
+		#ifdef	HEATER_FEEDFORWARD
+			// feed-forward, E rate in eighths of 1000 steps/s to stay within 32 bits
+			pid_output_intermed += (
+				heaters_pid[h].ff_e_factor * (int32_t) (dda_e_rate() >> 3) / 125 +
+				heaters_pid[h].ff_t_factor * (int32_t) (target_temp >> 2)
+			) / PID_SCALE;
+		#endif
+
 		// rebase and limit factors
 		if (pid_output_intermed > 255)
 			pid_output = 255;
@@ -255,6 +468,11 @@ void heater_tick(heater_t h, temp_sensor_t t, uint16_t current_temp, uint16_t ta
 			pid_output = BANG_BANG_ON;
 	#endif
 
+	#ifdef	PID_AUTOTUNE
+		if (autotune.sensor == t)
+			pid_output = autotune_tick(h, current_temp, target_temp);
+	#endif
+
 	#ifdef	HEATER_SANITY_CHECK
 	// check heater sanity
 	// implementation is a moving window with some slow-down to compensate for thermal mass
@@ -407,11 +625,39 @@ void pid_set_i_limit(heater_t index, int32_t i_limit) {
 	#endif /* BANG_BANG */
 }
 
+#ifdef	HEATER_FEEDFORWARD
+/** \brief set heater feed-forward factor for extrusion
+	\param index heater to change factor for
+	\param e scaled factor, PWM per 1000 E steps per second
+*/
+void pid_set_ff_e(heater_t index, int32_t e) {
+	if (index >= NUM_HEATERS)
+		return;
+
+	heaters_pid[index].ff_e_factor = e;
+}
+
+/** \brief set heater feed-forward factor for target temperature
+	\param index heater to change factor for
+	\param t scaled factor, PWM per degree
+*/
+void pid_set_ff_t(heater_t index, int32_t t) {
+	if (index >= NUM_HEATERS)
+		return;
+
+	heaters_pid[index].ff_t_factor = t;
+}
+#endif	/* HEATER_FEEDFORWARD */
+
 #ifndef	EXTRUDER
 /** \brief send heater debug info to host
 	\param i index of heater to send info for
 */
 void heater_print(uint16_t i) {
-	sersendf_P(PSTR("P:%ld I:%ld D:%ld Ilim:%u crc:%u "), heaters_pid[i].p_factor, heaters_pid[i].i_factor, heaters_pid[i].d_factor, heaters_pid[i].i_limit, crc_block(&heaters_pid[i].p_factor, 14));
+	sersendf_P(PSTR("P:%ld I:%ld D:%ld Ilim:%u "), heaters_pid[i].p_factor, heaters_pid[i].i_factor, heaters_pid[i].d_factor, heaters_pid[i].i_limit);
+	#ifdef	HEATER_FEEDFORWARD
+		sersendf_P(PSTR("FFE:%ld FFT:%ld "), heaters_pid[i].ff_e_factor, heaters_pid[i].ff_t_factor);
+	#endif
+	sersendf_P(PSTR("crc:%u "), crc_block(&heaters_pid[i].p_factor, sizeof(heaters_pid[i])));
 }
 #endif
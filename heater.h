@@ -31,6 +31,23 @@ void pid_set_i(heater_t index, int32_t i);
 void pid_set_d(heater_t index, int32_t d);
 void pid_set_i_limit(heater_t index, int32_t i_limit);
 
+#ifdef	HEATER_FEEDFORWARD
+#ifdef	BANG_BANG
+	#error HEATER_FEEDFORWARD needs the PID loop, BANG_BANG drops it
+#endif
+void pid_set_ff_e(heater_t index, int32_t e);
+void pid_set_ff_t(heater_t index, int32_t t);
+#endif
+
 void heater_print(uint16_t i);
 
+#ifdef	PID_AUTOTUNE
+#ifdef	BANG_BANG
+	#error PID_AUTOTUNE needs the PID loop, BANG_BANG drops it
+#endif
+void heater_autotune(temp_sensor_t t, uint16_t temperature);
+void heater_autotune_stop(void);
+uint8_t heater_autotune_running(void);
+#endif
+
 #endif	/* _HEATER_H */
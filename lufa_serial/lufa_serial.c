@@ -188,6 +188,24 @@ uint8_t serial_rxchars(void)
         return Endpoint_IsOUTReceived();
 }
 
+/* There's no receive buffer here to count line ends in. The parser takes
+ * lines piecewise anyway, so each character received counts as a line. This
+ * also keeps the main loop polling USB_USBTask() through serial_rxchars(). */
+uint8_t serial_rxlines(void)
+{
+	return serial_rxchars();
+}
+
+/* USB holds back the host while the endpoint is full, nothing gets lost, so
+ * report the room left in the endpoint bank. */
+uint8_t serial_rxfree(void)
+{
+	if (serial_rxchars() == 0)
+	  return CDC_TXRX_EPSIZE;
+
+	return CDC_TXRX_EPSIZE - Endpoint_BytesInEndpoint();
+}
+
 uint8_t serial_popchar(void)
 {
 	if (USB_DeviceState != DEVICE_STATE_Configured)
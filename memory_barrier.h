@@ -13,7 +13,13 @@
 // not just volatile ones. However, cached local variables
 // are not affected as they are not externally visible.
 
-#define MEMORY_BARRIER() __asm volatile( "" ::: "memory" )
+#ifdef SIMULATOR
+	// the simulator lets interrupts come due here, see simulator/simulator.c
+	void sim_barrier(void);
+	#define MEMORY_BARRIER() sim_barrier()
+#else
+	#define MEMORY_BARRIER() __asm volatile( "" ::: "memory" )
+#endif
 
 // There is a bug in the CLI/SEI functions in older versions of
 // avr-libc - they should be defined to include a memory barrier.
@@ -46,6 +46,8 @@
 #include	"arduino.h"
 #include	"clock.h"
 #include	"intercom.h"
+#include	"arc.h"
+#include	"gcode_binary.h"
 
 /// initialise all I/O - set pins as input or output, turn off unused subsystems, etc
 void io_init(void) {
@@ -256,12 +258,39 @@ int main (void)
 	// main loop
 	for (;;)
 	{
+		#ifdef ARC_SUPPORT
+		if (arc_busy()) {
+			// split the current arc into moves as the queue frees up, don't
+			// read the next command before we're done
+			if (queue_full() == 0)
+				arc_step();
+		}
+		else
+		#endif
 		// if queue is full, no point in reading chars- host will just have to wait
-		if ((serial_rxchars() != 0) && (queue_full() == 0)) {
-			uint8_t c = serial_popchar();
-			gcode_parse_char(c);
+		// meanwhile, the host can send the next lines ahead into the RX buffer
+		#ifdef BINARY_GCODE
+		if (binary_mode) {
+			if ((serial_rxchars() != 0) && (queue_full() == 0))
+				binary_parse_char(serial_popchar());
+		}
+		else
+		#endif
+		if ((serial_rxlines() != 0) && (queue_full() == 0)) {
+			// parse a whole line in one go
+			uint8_t c;
+
+			do {
+				c = serial_popchar();
+				gcode_parse_char(c);
+			} while ((c != 10) && (c != 13) && (serial_rxchars() != 0));
 		}
 
+		#ifdef STEP_RING_SIZE
+			// work out the next steps while the step interrupt does the current ones
+			dda_fill_ring();
+		#endif
+
 		ifclock(clock_flag_10ms) {
 			clock_10ms();
 		}
@@ -156,11 +156,81 @@ Extruder
 #endif
 
 /*
-End Step - All Steppers
-(so we don't have to delay in interrupt context)
+Step Pulses - All Steppers
+
+Writing ones to PINx toggles these pins of the port, leaving the others
+alone. So step pins sharing a port, like X and Y on RAMPS, are raised by one
+write and lowered by another, and their pulses start at the same time.
+Which pins share a port is sorted out at compile time.
+*/
+
+/// axis bits, for the axes a move steps and the step pins to raise
+#define	AXIS_X					0x01
+#define	AXIS_Y					0x02
+#define	AXIS_Z					0x04
+#define	AXIS_E					0x08
+
+// axes without a step pin have no bit on the port of X
+#define	X_STEP_IO				X_STEP_PIN
+#define	X_STEP_BIT			PIN_BIT(X_STEP_PIN)
+#define	Y_STEP_IO				Y_STEP_PIN
+#define	Y_STEP_BIT			PIN_BIT(Y_STEP_PIN)
+#if defined Z_STEP_PIN && defined Z_DIR_PIN
+	#define	Z_STEP_IO			Z_STEP_PIN
+	#define	Z_STEP_BIT		PIN_BIT(Z_STEP_PIN)
+#else
+	#define	Z_STEP_IO			X_STEP_PIN
+	#define	Z_STEP_BIT		0
+#endif
+#if defined E_STEP_PIN && defined E_DIR_PIN
+	#define	E_STEP_IO			E_STEP_PIN
+	#define	E_STEP_BIT		PIN_BIT(E_STEP_PIN)
+#else
+	#define	E_STEP_IO			X_STEP_PIN
+	#define	E_STEP_BIT		0
+#endif
+
+/// whether the step pins of axes a and b are on the same port
+#define	STEP_SAME(a, b)				SAME_PORT(a ## _STEP_IO, b ## _STEP_IO)
+/// bit of axis b in axes, if on the port of axis a
+#define	STEP_ON(a, b, axes)		((STEP_SAME(a, b) && ((axes) & AXIS_ ## b)) ? b ## _STEP_BIT : 0)
+/// step pins of the axes in axes on the port of an axis, leaving out axes before it
+#define	STEP_PORT_X(axes)			(STEP_ON(X, X, axes) | STEP_ON(X, Y, axes) | STEP_ON(X, Z, axes) | STEP_ON(X, E, axes))
+#define	STEP_PORT_Y(axes)			(STEP_ON(Y, Y, axes) | STEP_ON(Y, Z, axes) | STEP_ON(Y, E, axes))
+#define	STEP_PORT_Z(axes)			(STEP_ON(Z, Z, axes) | STEP_ON(Z, E, axes))
+#define	STEP_PORT_E(axes)			STEP_ON(E, E, axes)
+/// whether an axis is the first one on its port
+#define	STEP_FIRST_Y					( ! STEP_SAME(Y, X))
+#define	STEP_FIRST_Z					( ! STEP_SAME(Z, X) && ! STEP_SAME(Z, Y))
+#define	STEP_FIRST_E					( ! STEP_SAME(E, X) && ! STEP_SAME(E, Y) && ! STEP_SAME(E, Z))
+
+/*! start step pulses
+	\param axes the axes to step, AXIS_* bits
+
+	One write per port with step pins, all pins have to be low, see dda_step().
 */
+static inline void step_pins(uint8_t axes) __attribute__ ((always_inline));
+static inline void step_pins(uint8_t axes) {
+	TOGGLE_PORT(X_STEP_IO, STEP_PORT_X(axes));
+	if (STEP_FIRST_Y)
+		TOGGLE_PORT(Y_STEP_IO, STEP_PORT_Y(axes));
+	if (STEP_FIRST_Z)
+		TOGGLE_PORT(Z_STEP_IO, STEP_PORT_Z(axes));
+	if (STEP_FIRST_E)
+		TOGGLE_PORT(E_STEP_IO, STEP_PORT_E(axes));
+}
 
-#define unstep() 							do { _x_step(0); _y_step(0); _z_step(0); _e_step(0); } while (0)
+/// end all step pulses, so we don't have to delay in interrupt context
+static inline void unstep(void) __attribute__ ((always_inline));
+static inline void unstep(void) {
+	TOGGLE_PORT(X_STEP_IO, PORT_LEVELS(X_STEP_IO) & STEP_PORT_X(0xFF));
+	if (STEP_FIRST_Y)
+		TOGGLE_PORT(Y_STEP_IO, PORT_LEVELS(Y_STEP_IO) & STEP_PORT_Y(0xFF));
+	if (STEP_FIRST_Z)
+		TOGGLE_PORT(Z_STEP_IO, PORT_LEVELS(Z_STEP_IO) & STEP_PORT_Z(0xFF));
+	if (STEP_FIRST_E)
+		TOGGLE_PORT(E_STEP_IO, PORT_LEVELS(E_STEP_IO) & STEP_PORT_E(0xFF));
+}
 
 /*
 Stepper Enable Pins
@@ -0,0 +1,110 @@
+#include	"profile.h"
+
+/** \file
+	\brief Step interrupt profiler - where do our CPU cycles go?
+
+	With STEP_PROFILE defined, the step interrupt and the functions it calls
+	measure their own run time with timer 1, which runs at the CPU clock.
+	For each of them, we keep the number of runs, minimum, maximum and mean
+	time and a histogram, which M251 reports to the host.
+
+	Measured times include interrupts nested into the measured code, but not
+	the interrupt entry and exit code the compiler adds, which is about 40
+	clock ticks more per step interrupt.
+
+	The analog interrupt is measured as well, as it competes with the step
+	interrupt for CPU time. Its count over a known time gives its rate.
+
+	From the mean time of the step interrupt, the report also estimates the
+	highest step rate the CPU could handle with nothing else to do.
+*/
+
+#include	<string.h>
+#include	<avr/pgmspace.h>
+
+#include	"serial.h"
+#include	"sersendf.h"
+
+#ifdef	STEP_PROFILE
+
+/// statistics, written by the measured code, read by profile_report()
+static PROFILE profiles[PROFILE_COUNT];
+
+/// names of the measured code paths, in the order of the enum in profile.h
+static const char profile_names[PROFILE_COUNT][5] PROGMEM = {
+	"isr", "qstp", "dstp", "next", "adc"
+};
+
+/*! add a sample
+	\param which code path the sample belongs to
+	\param ticks run time in CPU clock ticks
+
+	Called from interrupts as well as from the main loop.
+*/
+void profile_add(uint8_t which, uint16_t ticks) {
+	PROFILE *p = &profiles[which];
+	uint8_t bin = 0, i;
+	uint16_t t = ticks >> 6;
+
+	uint8_t sreg = SREG;
+	cli();
+
+	// halve counts instead of overflowing, this keeps the mean and the histogram shape
+	if (p->sum > 0xFFFFFFFF - ticks) {
+		p->sum >>= 1;
+		p->count >>= 1;
+	}
+	p->sum += ticks;
+	p->count++;
+	if (ticks < p->min || p->count == 1)
+		p->min = ticks;
+	if (ticks > p->max)
+		p->max = ticks;
+
+	while (t && bin < PROFILE_BINS - 1) {
+		t >>= 1;
+		bin++;
+	}
+	if (p->histogram[bin] == 0xFFFF) {
+		for (i = 0; i < PROFILE_BINS; i++)
+			p->histogram[i] >>= 1;
+	}
+	p->histogram[bin]++;
+
+	SREG = sreg;
+}
+
+/// clear all statistics
+void profile_reset() {
+	uint8_t sreg = SREG;
+	cli();
+	memset(profiles, 0, sizeof(profiles));
+	SREG = sreg;
+}
+
+/// send all statistics to the host, one line per code path
+void profile_report() {
+	PROFILE p;
+	uint8_t i, j;
+	uint16_t mean;
+
+	for (i = 0; i < PROFILE_COUNT; i++) {
+		uint8_t sreg = SREG;
+		cli();
+		memcpy(&p, &profiles[i], sizeof(PROFILE));
+		SREG = sreg;
+
+		mean = p.count ? p.sum / p.count : 0;
+		if (i)
+			serial_writechar('\n');
+		serial_writestr_P(profile_names[i]);
+		sersendf_P(PSTR(" n:%lu min:%u max:%u mean:%u h:"), p.count, p.min, p.max, mean);
+		for (j = 0; j < PROFILE_BINS; j++)
+			sersendf_P(PSTR(" %u"), p.histogram[j]);
+		if (i == PROFILE_ISR && mean)
+			sersendf_P(PSTR(" max rate:%lu"), F_CPU / mean);
+	}
+	// newline is sent from gcode_parse after we return
+}
+
+#endif	/* STEP_PROFILE */
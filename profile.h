@@ -0,0 +1,67 @@
+#ifndef	_PROFILE_H
+#define	_PROFILE_H
+
+#include	<stdint.h>
+#include	<avr/io.h>
+#include	<avr/interrupt.h>
+
+#include	"config.h"
+
+#ifdef	STEP_PROFILE
+
+/// number of histogram bins, bin i counts samples below 64 << i ticks, the last one all others
+#define	PROFILE_BINS		8
+
+/// code paths we measure
+enum {
+	PROFILE_ISR,				///< step interrupt, TIMER1_COMPA_vect
+	PROFILE_QUEUE_STEP,	///< queue_step()
+	PROFILE_DDA_STEP,		///< dda_step()
+	PROFILE_NEXT_MOVE,	///< next_move()
+	PROFILE_ADC,				///< analog interrupt, ADC_vect
+	PROFILE_COUNT
+};
+
+/// statistics of one code path, times in CPU clock ticks
+typedef struct {
+	uint32_t	count;		///< number of samples
+	uint32_t	sum;			///< sum of all samples
+	uint16_t	min;			///< shortest sample
+	uint16_t	max;			///< longest sample
+	uint16_t	histogram[PROFILE_BINS];
+} PROFILE;
+
+/// read timer 1, which counts CPU clock ticks, safe against interrupts using the 16 bit TEMP register
+static inline uint16_t profile_time(void) __attribute__ ((always_inline));
+static inline uint16_t profile_time(void) {
+	uint8_t sreg = SREG;
+	uint16_t t;
+
+	cli();
+	t = TCNT1;
+	SREG = sreg;
+	return t;
+}
+
+// add a sample
+void profile_add(uint8_t which, uint16_t ticks);
+
+// clear all statistics
+void profile_reset(void);
+
+// send all statistics to the host
+void profile_report(void);
+
+/// start measuring a code path, PROFILE_START(DDA_STEP) at the beginning of dda_step()
+#define	PROFILE_START(name)	uint16_t profile_start_ ## name = profile_time()
+/// stop measuring and record the sample
+#define	PROFILE_END(name)		profile_add(PROFILE_ ## name, profile_time() - profile_start_ ## name)
+
+#else
+
+#define	PROFILE_START(name)
+#define	PROFILE_END(name)
+
+#endif	/* STEP_PROFILE */
+
+#endif	/* _PROFILE_H */
@@ -6,24 +6,87 @@ BAUD=115200
 waitfor avrdude
 stty $BAUD raw ignbrk -hup -echo ixon < $DEV
 
+# With OK_CREDITS, each ok tells the free space in the receive buffer as
+# "R:<bytes>". As long as the next line fits into it, less the lines sent
+# since the acknowledged one, we send ahead instead of waiting for the ok.
+# Without, each line waits for the ok of the line before. On a resend
+# request, all lines in flight are sent again, from the oldest.
 (
+	INFLIGHT=()	# lines sent, but not acknowledged yet
+	SENT=0		# sum of their lengths
+	FREE=0		# receive buffer space as of the last ok, -1 if not known
+	RSC=0		# resends of the oldest line in flight
+
+	# wait for the next ok or resend request
+	reply() {
+		while true
+		do
+			read -s -u 3 ANSWER
+			echo "< $ANSWER"
+			case "$ANSWER" in
+				*ok*|*OK*|rs*|RESEND*) break ;;
+			esac
+		done
+	}
+
+	# wait for the reply to the oldest line in flight
+	ack() {
+		reply
+		case "$ANSWER" in
+			rs*|RESEND*)
+				# numbered lines after it are refused as well, collect their replies
+				for (( N = 1; N < ${#INFLIGHT[@]}; N++ ))
+				do
+					reply
+				done
+				if [ "$RSC" -le 3 ]
+				then
+					RSC=$(( $RSC + 1 ))
+				else
+					echo "Too many retries: aborting" >&2
+					RSC=0
+					SENT=$(( $SENT - ${#INFLIGHT[0]} - 1 ))
+					INFLIGHT=("${INFLIGHT[@]:1}")
+				fi
+				for L in "${INFLIGHT[@]}"
+				do
+					echo "> $L"
+					echo "$L" >&3
+				done
+				FREE=-1
+				return
+				;;
+		esac
+		RSC=0
+		SENT=$(( $SENT - ${#INFLIGHT[0]} - 1 ))
+		INFLIGHT=("${INFLIGHT[@]:1}")
+		if [[ "$ANSWER" =~ R:([0-9]+) ]]
+		then
+			FREE=${BASH_REMATCH[1]}
+		else
+			FREE=-1
+		fi
+	}
+
 	read -t 0.1; RV=$?
 	while [ $RV -eq 0 ] || [ $RV -ge 128 ]
 	do
 		if [ $RV -eq 0 ]
 		then
+			LEN=$(( ${#REPLY} + 1 ))
+			while [ ${#INFLIGHT[@]} -gt 0 ] && [ $(( $SENT + $LEN )) -gt $FREE ]
+			do
+				ack
+			done
 			echo "> $REPLY"
 			echo "$REPLY" >&3
+			INFLIGHT+=("$REPLY")
+			SENT=$(( $SENT + $LEN ))
 		fi
-		while [ "$REPLY" != "OK" ] && [ "$REPLY" != "ok" ]
-		do
-			read -s -u 3
-			echo "< $REPLY"
-                        case "$REPLY" in
-                                *ok*) REPLY=OK ;;
-                                *OK*) REPLY=OK ;;
-                        esac
-		done
 		read -t 1; RV=$?
 	done
+	while [ ${#INFLIGHT[@]} -gt 0 ]
+	do
+		ack
+	done
 ) 3<>$DEV
@@ -7,6 +7,8 @@
 
 	It uses ringbuffers for both transmit and receive, and intelligently decides whether to wait or drop transmitted characters if the buffer is full.
 
+	The receive buffer counts complete lines as they come in, so the main loop can hand whole commands to the parser, while the host sends the next lines ahead. See RX_BUFSIZE in config.h.
+
 	It also supports XON/XOFF flow control of the receive buffer, to help avoid overruns.
 */
 
@@ -15,8 +17,17 @@
 #include	"config.h"
 #include	"arduino.h"
 
-/// size of TX and RX buffers. MUST be a \f$2^n\f$ value
-#define		BUFSIZE			64
+/// size of TX buffer. MUST be a \f$2^n\f$ value
+#define		BUFSIZE_tx	64
+
+#ifndef	RX_BUFSIZE
+	#define	RX_BUFSIZE	64
+#endif
+#if RX_BUFSIZE > 256 || RX_BUFSIZE & (RX_BUFSIZE - 1)
+	#error RX_BUFSIZE has to be a power of 2, 256 at most.
+#endif
+/// size of RX buffer
+#define		BUFSIZE_rx	RX_BUFSIZE
 
 /// ascii XOFF character
 #define		ASCII_XOFF	19
@@ -28,24 +39,28 @@ volatile uint8_t rxhead = 0;
 /// rx buffer tail pointer. Points to last character in buffer
 volatile uint8_t rxtail = 0;
 /// rx buffer
-volatile uint8_t rxbuf[BUFSIZE];
+volatile uint8_t rxbuf[BUFSIZE_rx];
+/// line ends received, written by the receive interrupt only
+volatile uint8_t rxlines_in = 0;
+/// line ends read, written outside of interrupts only
+volatile uint8_t rxlines_out = 0;
 
 /// tx buffer head pointer. Points to next available space.
 volatile uint8_t txhead = 0;
 /// tx buffer tail pointer. Points to last character in buffer
 volatile uint8_t txtail = 0;
 /// tx buffer
-volatile uint8_t txbuf[BUFSIZE];
+volatile uint8_t txbuf[BUFSIZE_tx];
 
 /// check if we can read from this buffer
-#define	buf_canread(buffer)			((buffer ## head - buffer ## tail    ) & (BUFSIZE - 1))
+#define	buf_canread(buffer)			((buffer ## head - buffer ## tail    ) & (BUFSIZE_ ## buffer - 1))
 /// read from buffer
-#define	buf_pop(buffer, data)		do { data = buffer ## buf[buffer ## tail]; buffer ## tail = (buffer ## tail + 1) & (BUFSIZE - 1); } while (0)
+#define	buf_pop(buffer, data)		do { data = buffer ## buf[buffer ## tail]; buffer ## tail = (buffer ## tail + 1) & (BUFSIZE_ ## buffer - 1); } while (0)
 
 /// check if we can write to this buffer
-#define	buf_canwrite(buffer)		((buffer ## tail - buffer ## head - 1) & (BUFSIZE - 1))
+#define	buf_canwrite(buffer)		((buffer ## tail - buffer ## head - 1) & (BUFSIZE_ ## buffer - 1))
 /// write to buffer
-#define	buf_push(buffer, data)	do { buffer ## buf[buffer ## head] = data; buffer ## head = (buffer ## head + 1) & (BUFSIZE - 1); } while (0)
+#define	buf_push(buffer, data)	do { buffer ## buf[buffer ## head] = data; buffer ## head = (buffer ## head + 1) & (BUFSIZE_ ## buffer - 1); } while (0)
 
 /*
 	ringbuffer logic:
@@ -110,8 +125,14 @@ ISR(USART_RX_vect)
 ISR(USART0_RX_vect)
 #endif
 {
-	if (buf_canwrite(rx))
-		buf_push(rx, UDR0);
+	uint8_t c;
+
+	if (buf_canwrite(rx)) {
+		c = UDR0;
+		buf_push(rx, c);
+		if (c == 10 || c == 13)
+			rxlines_in++;
+	}
 	else {
 		uint8_t trash;
 
@@ -166,18 +187,39 @@ uint8_t serial_rxchars()
 	return buf_canread(rx);
 }
 
+/// check how many characters can be received without overflowing the buffer
+uint8_t serial_rxfree()
+{
+	return buf_canwrite(rx);
+}
+
+/// check how many complete lines can be read
+///
+/// a full buffer counts as one line, so a line too long for the buffer doesn't block reading
+uint8_t serial_rxlines()
+{
+	uint8_t lines = rxlines_in - rxlines_out;
+
+	if (lines == 0 && buf_canwrite(rx) == 0)
+		lines = 1;
+	return lines;
+}
+
 /// read one character
 uint8_t serial_popchar()
 {
 	uint8_t c = 0;
 
 	// it's imperative that we check, because if the buffer is empty and we pop, we'll go through the whole buffer again
-	if (buf_canread(rx))
+	if (buf_canread(rx)) {
 		buf_pop(rx, c);
+		if (c == 10 || c == 13)
+			rxlines_out++;
+	}
 
 	#ifdef	XONXOFF
 	if ((flowflags & FLOWFLAG_STATE_XON) == 0 && buf_canread(rx) <= 16) {
-		// the buffer has (BUFSIZE - 16) free characters again, so send an XON
+		// the buffer has (RX_BUFSIZE - 16) free characters again, so send an XON
 		flowflags = FLOWFLAG_SEND_XON;
 		UCSR0B |= MASK(UDRIE0);
 	}
@@ -11,6 +11,9 @@ void serial_init(void);
 // return number of characters in the receive buffer, and number of spaces in the send buffer
 uint8_t serial_rxchars(void);
 // uint8_t serial_txchars(void);
+// return number of complete lines in the receive buffer, and free space in it
+uint8_t serial_rxlines(void);
+uint8_t serial_rxfree(void);
 
 // read one character
 uint8_t serial_popchar(void);
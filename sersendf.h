@@ -3,7 +3,14 @@
 
 #include	<avr/pgmspace.h>
 
+#ifndef	SIMULATOR
 void sersendf(char *format, ...)		__attribute__ ((format (printf, 1, 2)));
 void sersendf_P(PGM_P format, ...)	__attribute__ ((format (printf, 1, 2)));
+#else
+// %l is 32 bits for sersendf, but 64 bits for printf on the host, so formats
+// can be checked in the AVR build only
+void sersendf(char *format, ...);
+void sersendf_P(PGM_P format, ...);
+#endif
 
 #endif	/* _SERSENDF_H */
@@ -0,0 +1,148 @@
+/** \file
+	\brief Host test of the relay autotune in heater.c against a thermal model
+
+	Build and run with "make sim-test", using config.h like the simulator.
+	PID_AUTOTUNE is defined here, whatever config.h says.
+
+	The hot end is a heater block and a sensor, each lagging behind: the
+	heater's power follows the PWM output with a time constant of 1 s, the
+	block loses heat to the room, the sensor follows the block with a time
+	constant of 3 s. Heater ticks come every 10 ms, like from clock.c.
+
+	The autotune has to refuse a sensor without a heater. It runs in the
+	background, so it has to keep running for a minute of heater ticks, then
+	stop when the target temperature changes, leaving the factors alone.
+	Started again, it has to finish within an hour at 200 C. With the factors found, heating up from room
+	temperature has to settle within 1 C of the target after 10 minutes,
+	overshooting by less than 10 C. Prints what it found and exits with 1
+	if any of this fails.
+*/
+
+#include	<stdio.h>
+
+#define	PID_AUTOTUNE
+// heaters_runtime and heaters_pid are static, so take heater.c in
+#include	"heater.c"
+#include	"serial.h"
+
+#define	SIM_REG8(name)	volatile uint8_t name;
+#define	SIM_REG16(name)	volatile uint16_t name;
+#include	"registers.h"
+#undef	SIM_REG8
+#undef	SIM_REG16
+
+/// room temperature [C]
+#define	ROOM		25.
+/// heater power at full output [W]
+#define	POWER		20.
+/// heat capacity of the block [J/K]
+#define	CAPACITY	4.
+/// losses of the block to the room [W/K]
+#define	LOSSES		0.08
+
+/// target temperatures temp_set() got, 14.2 fixed point
+static uint16_t target[NUM_TEMP_SENSORS];
+/// what temp_has_heater() reports
+static uint8_t has_heater = 255;
+
+void temp_set(temp_sensor_t index, uint16_t temperature) {
+	if (index < NUM_TEMP_SENSORS)
+		target[index] = temperature;
+}
+
+uint8_t temp_has_heater(temp_sensor_t index) {
+	return (index < NUM_TEMP_SENSORS) ? has_heater : 0;
+}
+
+#ifdef	HEATER_FEEDFORWARD
+/// nothing is extruded
+uint32_t dda_e_rate() {
+	return 0;
+}
+#endif
+
+void sim_pins_written() {
+}
+
+/// the hot end, heater power [W], block and sensor temperature [C]
+static double power, block, sensor;
+
+/// reset the hot end to room temperature
+static void model_init(void) {
+	power = 0.;
+	block = sensor = ROOM;
+}
+
+/// one heater tick of 10 ms
+static void model_tick(void) {
+	double	dt = 0.01;
+
+	heater_tick(0, 0, (uint16_t) (sensor * 4.), target[0]);
+	power += (POWER * heaters_runtime[0].heater_output / 255. - power) * dt / 1.;
+	block += (power - LOSSES * (block - ROOM)) / CAPACITY * dt;
+	sensor += (block - sensor) * dt / 3.;
+}
+
+int main(void) {
+	uint32_t	n;
+	double		max = 0.;
+	uint8_t		bad = 0;
+	int32_t		p_factor;
+
+	heater_init();
+
+	has_heater = 0;
+	heater_autotune(0, 200 * 4);
+	// the end of the line, usually sent by gcode_parse.c
+	serial_writechar('\n');
+	if (heater_autotune_running()) {
+		printf("autotune started on a sensor without a heater\n");
+		heater_autotune_stop();
+		bad = 1;
+	}
+	has_heater = 255;
+
+	model_init();
+	heater_autotune(0, 200 * 4);
+	for (n = 0; n < 100L * 60; n++)
+		model_tick();
+	if ( ! heater_autotune_running()) {
+		printf("autotune stopped within a minute\n");
+		bad = 1;
+	}
+	p_factor = heaters_pid[0].p_factor;
+	// like M104 S210
+	temp_set(0, 210 * 4);
+	model_tick();
+	if (heater_autotune_running() || target[0] != 210 * 4 ||
+	    heaters_pid[0].p_factor != p_factor) {
+		printf("a new target didn't stop the autotune cleanly\n");
+		heater_autotune_stop();
+		bad = 1;
+	}
+
+	model_init();
+	heater_autotune(0, 200 * 4);
+	for (n = 0; heater_autotune_running() && n < 100L * 3600; n++)
+		model_tick();
+	printf("autotune took %u s\n", n / 100);
+	if (heater_autotune_running()) {
+		printf("autotune didn't finish within an hour\n");
+		heater_autotune_stop();
+		bad = 1;
+	}
+
+	model_init();
+	temp_set(0, 200 * 4);
+	for (n = 0; n < 100L * 600; n++) {
+		model_tick();
+		if (sensor > max)
+			max = sensor;
+	}
+	printf("after 10 minutes at 200 C: %.2f C, overshoot %.2f C\n", sensor, max - 200.);
+	if (sensor < 199. || sensor > 201. || max > 210.)
+		bad = 1;
+
+	printf("autotune: %s\n", bad ? "failed" : "ok");
+	return bad;
+}
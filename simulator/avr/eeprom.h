@@ -0,0 +1,21 @@
+/** \file
+	\brief Simulator stand-in for <avr/eeprom.h>
+
+	EEMEM variables live in RAM, so they're lost when the simulator exits.
+*/
+
+#ifndef	_SIM_AVR_EEPROM_H
+#define	_SIM_AVR_EEPROM_H
+
+#include	<stdint.h>
+
+#define	EEMEM
+
+#define	eeprom_read_byte(p)				(*(const uint8_t *) (p))
+#define	eeprom_read_word(p)				(*(const uint16_t *) (p))
+#define	eeprom_read_dword(p)			(*(const uint32_t *) (p))
+#define	eeprom_write_byte(p, v)		do { *(uint8_t *) (p) = (v); } while (0)
+#define	eeprom_write_word(p, v)		do { *(uint16_t *) (p) = (v); } while (0)
+#define	eeprom_write_dword(p, v)	do { *(uint32_t *) (p) = (v); } while (0)
+
+#endif	/* _SIM_AVR_EEPROM_H */
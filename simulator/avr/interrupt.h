@@ -0,0 +1,19 @@
+/** \file
+	\brief Simulator stand-in for <avr/interrupt.h>
+
+	Interrupts happen only when simulated time advances, see simulator.c.
+*/
+
+#ifndef	_SIM_AVR_INTERRUPT_H
+#define	_SIM_AVR_INTERRUPT_H
+
+#include	<avr/io.h>
+
+#include	"simulator.h"
+
+#define	ISR(vector, ...)	void vector(void); void vector(void)
+
+#define	sei()	do { SREG |= (1 << SREG_I); } while (0)
+#define	cli()	sim_cli()
+
+#endif	/* _SIM_AVR_INTERRUPT_H */
@@ -0,0 +1,163 @@
+/** \file
+	\brief Simulator stand-in for <avr/io.h>
+
+	I/O registers are plain variables, defined in simulator.c. Only what the
+	firmware for an ATmega1280 actually uses is here.
+*/
+
+#ifndef	_SIM_AVR_IO_H
+#define	_SIM_AVR_IO_H
+
+#include	<stdint.h>
+
+#define	SIM_REG8(name)	extern volatile uint8_t name;
+#define	SIM_REG16(name)	extern volatile uint16_t name;
+#include	"registers.h"
+#undef	SIM_REG8
+#undef	SIM_REG16
+
+// like avr-libc, so the firmware can check whether a register exists
+#define	OCR1C		OCR1C
+
+#define	RAMEND	0x21FF
+#define	E2END		0x0FFF
+
+// timers
+enum { CS10 = 0, CS11, CS12, WGM12, WGM13 };
+enum { WGM10 = 0, WGM11, COM1C0, COM1C1, COM1B0, COM1B1, COM1A0, COM1A1 };
+enum { TOIE1 = 0, OCIE1A, OCIE1B, OCIE1C };
+enum { TOV1 = 0, OCF1A, OCF1B, OCF1C };
+#define	CS00		CS10
+#define	CS01		CS11
+#define	CS02		CS12
+#define	CS20		CS10
+#define	CS21		CS11
+#define	CS22		CS12
+#define	WGM00		WGM10
+#define	WGM01		WGM11
+#define	WGM20		WGM10
+#define	WGM21		WGM11
+#define	COM0A1	COM1A1
+#define	COM0B1	COM1B1
+#define	COM2A1	COM1A1
+#define	COM2B1	COM1B1
+#define	OCIE0A	OCIE1A
+#define	OCIE0B	OCIE1B
+#define	OCIE2A	OCIE1A
+#define	OCIE2B	OCIE1B
+#define	TOIE0		TOIE1
+#define	TOIE2		TOIE1
+
+// power reduction, analog comparator
+enum { PRADC = 0, PRUSART0, PRSPI, PRTIM1, PRTIM0 = 5, PRTIM2, PRTWI };
+enum { ACD = 7 };
+
+// ADC
+enum { ADPS0 = 0, ADPS1, ADPS2, ADIE, ADIF, ADATE, ADSC, ADEN };
+enum { MUX0 = 0, MUX1, MUX2, MUX3, MUX4, ADLAR, REFS0, REFS1 };
+enum { ADTS0 = 0, ADTS1, ADTS2, MUX5, ACME = 6 };
+
+// USART
+enum { MPCM0 = 0, U2X0, UPE0, DOR0, FE0, UDRE0, TXC0, RXC0 };
+enum { TXB80 = 0, RXB80, UCSZ02, TXEN0, RXEN0, UDRIE0, TXCIE0, RXCIE0 };
+enum { UCPOL0 = 0, UCSZ00, UCSZ01, USBS0, UPM00, UPM01, UMSEL00, UMSEL01 };
+
+// SPI
+enum { SPR0 = 0, SPR1, CPHA, CPOL, MSTR, DORD, SPE, SPIE };
+enum { SPI2X = 0, WCOL = 6, SPIF };
+
+// status register, watchdog
+enum { SREG_I = 7 };
+enum { WDRF = 3 };
+
+// pin numbers within their port
+#define	PINA0	0
+#define	PINA1	1
+#define	PINA2	2
+#define	PINA3	3
+#define	PINA4	4
+#define	PINA5	5
+#define	PINA6	6
+#define	PINA7	7
+#define	PINB0	0
+#define	PINB1	1
+#define	PINB2	2
+#define	PINB3	3
+#define	PINB4	4
+#define	PINB5	5
+#define	PINB6	6
+#define	PINB7	7
+#define	PINC0	0
+#define	PINC1	1
+#define	PINC2	2
+#define	PINC3	3
+#define	PINC4	4
+#define	PINC5	5
+#define	PINC6	6
+#define	PINC7	7
+#define	PIND0	0
+#define	PIND1	1
+#define	PIND2	2
+#define	PIND3	3
+#define	PIND4	4
+#define	PIND5	5
+#define	PIND6	6
+#define	PIND7	7
+#define	PINE0	0
+#define	PINE1	1
+#define	PINE2	2
+#define	PINE3	3
+#define	PINE4	4
+#define	PINE5	5
+#define	PINE6	6
+#define	PINE7	7
+#define	PINF0	0
+#define	PINF1	1
+#define	PINF2	2
+#define	PINF3	3
+#define	PINF4	4
+#define	PINF5	5
+#define	PINF6	6
+#define	PINF7	7
+#define	PING0	0
+#define	PING1	1
+#define	PING2	2
+#define	PING3	3
+#define	PING4	4
+#define	PING5	5
+#define	PING6	6
+#define	PING7	7
+#define	PINH0	0
+#define	PINH1	1
+#define	PINH2	2
+#define	PINH3	3
+#define	PINH4	4
+#define	PINH5	5
+#define	PINH6	6
+#define	PINH7	7
+#define	PINJ0	0
+#define	PINJ1	1
+#define	PINJ2	2
+#define	PINJ3	3
+#define	PINJ4	4
+#define	PINJ5	5
+#define	PINJ6	6
+#define	PINJ7	7
+#define	PINK0	0
+#define	PINK1	1
+#define	PINK2	2
+#define	PINK3	3
+#define	PINK4	4
+#define	PINK5	5
+#define	PINK6	6
+#define	PINK7	7
+#define	PINL0	0
+#define	PINL1	1
+#define	PINL2	2
+#define	PINL3	3
+#define	PINL4	4
+#define	PINL5	5
+#define	PINL6	6
+#define	PINL7	7
+
+#endif	/* _SIM_AVR_IO_H */
@@ -0,0 +1,26 @@
+/** \file
+	\brief Simulator stand-in for <avr/pgmspace.h>
+
+	There's only one address space on the host, so flash is just memory.
+*/
+
+#ifndef	_SIM_AVR_PGMSPACE_H
+#define	_SIM_AVR_PGMSPACE_H
+
+#include	<stdint.h>
+#include	<string.h>
+
+#define	PROGMEM
+#define	PGM_P								const char *
+#define	PSTR(s)							(s)
+
+#define	pgm_read_byte(a)		(*(const uint8_t *) (a))
+#define	pgm_read_word(a)		(*(const uint16_t *) (a))
+#define	pgm_read_dword(a)		(*(const uint32_t *) (a))
+
+#define	memcpy_P						memcpy
+#define	strlen_P						strlen
+
+typedef char prog_char;
+
+#endif	/* _SIM_AVR_PGMSPACE_H */
@@ -0,0 +1,11 @@
+/** \file
+	\brief Simulator stand-in for <avr/version.h>
+*/
+
+#ifndef	_SIM_AVR_VERSION_H
+#define	_SIM_AVR_VERSION_H
+
+/// cli() and sei() of this version include a memory barrier
+#define	__AVR_LIBC_VERSION__	10700UL
+
+#endif	/* _SIM_AVR_VERSION_H */
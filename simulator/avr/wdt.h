@@ -0,0 +1,14 @@
+/** \file
+	\brief Simulator stand-in for <avr/wdt.h> - there's no watchdog
+*/
+
+#ifndef	_SIM_AVR_WDT_H
+#define	_SIM_AVR_WDT_H
+
+#define	WDTO_500MS			5
+
+#define	wdt_reset()			do { } while (0)
+#define	wdt_disable()		do { } while (0)
+#define	wdt_enable(t)		do { } while (0)
+
+#endif	/* _SIM_AVR_WDT_H */
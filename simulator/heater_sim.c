@@ -0,0 +1,110 @@
+#include	"temp.h"
+#include	"heater.h"
+
+/** \file
+	\brief Temperature and heater stand-ins for the simulator
+
+	There are no sensors, every sensor reads its target temperature right
+	away, so waiting for temperatures takes no time.
+*/
+
+#include	"sersendf.h"
+
+/// target temperatures, 14.2 fixed point like in temp.c
+static uint16_t	target_temp[NUM_TEMP_SENSORS];
+
+void temp_init() {
+}
+
+void temp_sensor_tick() {
+}
+
+/// temperatures are always reached
+uint8_t	temp_achieved() {
+	return 255;
+}
+
+/// specify a target temperature
+void temp_set(temp_sensor_t index, uint16_t temperature) {
+	if (index < NUM_TEMP_SENSORS)
+		target_temp[index] = temperature;
+}
+
+/// read a temperature, which is always the target temperature
+uint16_t temp_get(temp_sensor_t index) {
+	return (index < NUM_TEMP_SENSORS) ? target_temp[index] : 0;
+}
+
+/// all sensors have a heater
+uint8_t temp_has_heater(temp_sensor_t index) {
+	return (index < NUM_TEMP_SENSORS) ? 255 : 0;
+}
+
+/// check whether all heaters are off
+uint8_t temp_all_zero() {
+	uint8_t i;
+
+	for (i = 0; i < NUM_TEMP_SENSORS; i++)
+		if (target_temp[i])
+			return 0;
+	return 255;
+}
+
+/// send temperatures to host, same format as temp.c
+void temp_print(temp_sensor_t index) {
+	if (index >= NUM_TEMP_SENSORS)
+		return;
+
+	sersendf_P(PSTR("\nT:%u.%u"), target_temp[index] >> 2, (target_temp[index] & 3) * 25);
+}
+
+void heater_init() {
+}
+
+void heater_save_settings() {
+}
+
+void heater_set(heater_t index, uint8_t value) {
+}
+
+void heater_tick(heater_t h, temp_sensor_t t, uint16_t current_temp, uint16_t target_temp) {
+}
+
+uint8_t heaters_all_off() {
+	return 255;
+}
+
+void pid_set_p(heater_t index, int32_t p) {
+}
+
+void pid_set_i(heater_t index, int32_t i) {
+}
+
+void pid_set_d(heater_t index, int32_t d) {
+}
+
+void pid_set_i_limit(heater_t index, int32_t i_limit) {
+}
+
+void heater_print(uint16_t i) {
+}
+
+#ifdef	PID_AUTOTUNE
+void heater_autotune(temp_sensor_t t, uint16_t temperature) {
+}
+
+void heater_autotune_stop() {
+}
+
+uint8_t heater_autotune_running() {
+	return 0;
+}
+#endif
+
+#ifdef	HEATER_FEEDFORWARD
+void pid_set_ff_e(heater_t index, int32_t e) {
+}
+
+void pid_set_ff_t(heater_t index, int32_t t) {
+}
+#endif
@@ -0,0 +1,25 @@
+#include	"home.h"
+
+/** \file
+	\brief Homing stand-in for the simulator
+
+	There are no endstops, so G161 and G162 leave the axes where they are.
+*/
+
+void home_x_negative(uint32_t feed) {
+}
+
+void home_x_positive(uint32_t feed) {
+}
+
+void home_y_negative(uint32_t feed) {
+}
+
+void home_y_positive(uint32_t feed) {
+}
+
+void home_z_negative(uint32_t feed) {
+}
+
+void home_z_positive(uint32_t feed) {
+}
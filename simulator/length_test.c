@@ -0,0 +1,123 @@
+/** \file
+	\brief Host test of decfloat_to_length(), the conversion of lengths to steps
+
+	Build and run with "make sim-test", using config.h like the simulator.
+
+	Random lengths with 0 to 5 decimals, in mm and in inches, for all axes and
+	for um (I, J and R), are converted and compared against the same
+	conversion done with doubles, rounded half away from zero. Then a series
+	of short relative moves has to add up to the rounded sum of their exact
+	lengths, carrying the fractions. Prints the number of mismatches and
+	exits with 1 if there are any.
+*/
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<math.h>
+
+// decfloat_to_length() and the fractions are static, so take the parser in
+#include	"gcode_parse.c"
+
+/// the parser's end of line handling calls these, never reached here
+void process_gcode_command() {
+}
+
+uint8_t queue_free() {
+	return 0;
+}
+
+/// units per meter or per 1000 inches, for X, Y, Z, E and um
+static const double units[2][5] = {
+	{ STEPS_PER_M_X, STEPS_PER_M_Y, STEPS_PER_M_Z, STEPS_PER_M_E, 1000000. },
+	{ STEPS_PER_KIN_X, STEPS_PER_KIN_Y, STEPS_PER_KIN_Z, STEPS_PER_KIN_E, 25400000. }
+};
+
+/// a random length in 1/10^5 mm or inches, below 10^4 with the given decimals
+static int32_t random_length(uint8_t decimals) {
+	int32_t	v = ((((uint32_t) rand() << 15) ^ rand()) % 1000000000UL);
+
+	v -= v % powers[5 - decimals];
+	return (rand() & 1) ? -v : v;
+}
+
+/// decfloat as the parser builds it from the digits of v / 10^5
+static decfloat to_decfloat(int32_t v, uint8_t decimals) {
+	decfloat	df;
+	uint32_t	a = v < 0 ? -v : v;
+
+	df.sign = v < 0;
+	df.mantissa = a / powers[5 - decimals];
+	// 0 without a decimal point, else 1 + number of decimals
+	df.exponent = decimals ? decimals + 1 : 0;
+	return df;
+}
+
+/// the exact conversion, done with doubles
+static int32_t reference(int32_t v, uint8_t inches, uint8_t unit) {
+	return lround((double) v * units[inches][unit] / 1e8);
+}
+
+int main(void) {
+	uint32_t	n, bad = 0, tests = 0;
+	uint8_t		inches, unit, decimals;
+	decfloat	df;
+	int32_t		v, got, want, sum;
+	double		exact;
+
+	srand(1);
+	for (inches = 0; inches < 2; inches++) {
+		next_target.option_inches = inches;
+		for (unit = 0; unit <= LENGTH_UM; unit++) {
+			for (n = 0; n < 200000; n++) {
+				decimals = n % 6;
+				v = random_length(decimals);
+				df = to_decfloat(v, decimals);
+				got = decfloat_to_length(&df, unit, NULL);
+				want = reference(v, inches, unit);
+				tests++;
+				if (got != want) {
+					if (bad++ < 10)
+						printf("%s %c %.5f: %d, expected %d\n", inches ? "in" : "mm",
+							"XYZEU"[unit], v / 1e5, got, want);
+				}
+			}
+
+			// values of 10^4 and above saturate
+			df = to_decfloat(0, 0);
+			df.mantissa = 12345;
+			got = decfloat_to_length(&df, unit, NULL);
+			want = reference(999999999, inches, unit);
+			tests++;
+			if (got != want) {
+				bad++;
+				printf("%s %c 12345: %d, expected %d\n", inches ? "in" : "mm",
+					"XYZEU"[unit], got, want);
+			}
+		}
+	}
+
+	// relative moves carry what's left over from rounding
+	next_target.option_inches = 0;
+	for (unit = 0; unit < LENGTH_UM; unit++) {
+		int32_t	fraction = 0;
+
+		sum = 0;
+		exact = 0.;
+		for (n = 0; n < 10000; n++) {
+			decimals = 1 + n % 5;
+			v = random_length(decimals) % 100000;
+			df = to_decfloat(v, decimals);
+			sum += decfloat_to_length(&df, unit, &fraction);
+			exact += (double) v * units[0][unit] / 1e8;
+		}
+		tests++;
+		if (sum != lround(exact)) {
+			bad++;
+			printf("%c: 10000 relative moves add up to %d, expected %.3f\n",
+				"XYZE"[unit], sum, exact);
+		}
+	}
+
+	printf("decfloat_to_length(): %u tests, %u mismatches\n", tests, bad);
+	return bad ? 1 : 0;
+}
@@ -0,0 +1,23 @@
+#!/usr/bin/python
+# -*- coding: utf-8 -*-
+#
+# Writes the G-code used to compare step interrupt times, e.g. with
+# RAMP_TABLE on and off: 2000 moves between random points of a 60 x 60 mm
+# square at F6000. Without LOOKAHEAD each move ramps up and down, so nearly
+# all steps are ramp steps. The points are always the same, so runs compare.
+#
+# Usage: python simulator/ramp_moves.py > ramps.gcode
+#        simulator/teacup_sim -q ramps.gcode
+#
+# The dda_step line of the simulator's summary tells the number of step
+# interrupts and the host time spent in each.
+
+import random
+import sys
+
+random.seed(1)
+sys.stdout.write("G21\nG90\n")
+for i in range(2000):
+	x = random.uniform(0, 60)
+	y = random.uniform(0, 60)
+	sys.stdout.write("G1 X%.2f Y%.2f F6000\n" % (x, y))
@@ -0,0 +1,38 @@
+/** \file
+	\brief I/O registers known to the simulator
+
+	Expanded by avr/io.h into declarations and by simulator.c into definitions.
+*/
+
+SIM_REG8(SREG)
+SIM_REG8(MCUSR)		SIM_REG8(PRR0)		SIM_REG8(PRR1)		SIM_REG8(ACSR)
+
+SIM_REG8(PINA)		SIM_REG8(PORTA)		SIM_REG8(DDRA)
+SIM_REG8(PINB)		SIM_REG8(PORTB)		SIM_REG8(DDRB)
+SIM_REG8(PINC)		SIM_REG8(PORTC)		SIM_REG8(DDRC)
+SIM_REG8(PIND)		SIM_REG8(PORTD)		SIM_REG8(DDRD)
+SIM_REG8(PINE)		SIM_REG8(PORTE)		SIM_REG8(DDRE)
+SIM_REG8(PINF)		SIM_REG8(PORTF)		SIM_REG8(DDRF)
+SIM_REG8(PING)		SIM_REG8(PORTG)		SIM_REG8(DDRG)
+SIM_REG8(PINH)		SIM_REG8(PORTH)		SIM_REG8(DDRH)
+SIM_REG8(PINJ)		SIM_REG8(PORTJ)		SIM_REG8(DDRJ)
+SIM_REG8(PINK)		SIM_REG8(PORTK)		SIM_REG8(DDRK)
+SIM_REG8(PINL)		SIM_REG8(PORTL)		SIM_REG8(DDRL)
+
+SIM_REG8(TCCR0A)	SIM_REG8(TCCR0B)	SIM_REG8(TCNT0)		SIM_REG8(OCR0A)		SIM_REG8(OCR0B)
+SIM_REG8(TIMSK0)	SIM_REG8(TIFR0)
+SIM_REG8(TCCR1A)	SIM_REG8(TCCR1B)	SIM_REG8(TCCR1C)	SIM_REG16(TCNT1)
+SIM_REG16(OCR1A)	SIM_REG16(OCR1B)	SIM_REG16(OCR1C)	SIM_REG8(TIMSK1)	SIM_REG8(TIFR1)
+SIM_REG8(TCCR2A)	SIM_REG8(TCCR2B)	SIM_REG8(TCNT2)		SIM_REG8(OCR2A)		SIM_REG8(OCR2B)
+SIM_REG8(TIMSK2)	SIM_REG8(TIFR2)
+SIM_REG8(TCCR3A)	SIM_REG8(TCCR3B)	SIM_REG16(OCR3A)	SIM_REG16(OCR3B)	SIM_REG16(OCR3C)
+SIM_REG8(TCCR4A)	SIM_REG8(TCCR4B)	SIM_REG16(OCR4A)	SIM_REG16(OCR4B)	SIM_REG16(OCR4C)
+SIM_REG8(TCCR5A)	SIM_REG8(TCCR5B)	SIM_REG16(OCR5A)	SIM_REG16(OCR5B)	SIM_REG16(OCR5C)
+
+SIM_REG8(ADMUX)		SIM_REG8(ADCSRA)	SIM_REG8(ADCSRB)	SIM_REG16(ADC)
+SIM_REG8(DIDR0)		SIM_REG8(DIDR2)
+
+SIM_REG8(UCSR0A)	SIM_REG8(UCSR0B)	SIM_REG8(UCSR0C)	SIM_REG8(UDR0)
+SIM_REG16(UBRR0)	SIM_REG8(UBRR0H)	SIM_REG8(UBRR0L)
+
+SIM_REG8(SPCR)		SIM_REG8(SPSR)		SIM_REG8(SPDR)
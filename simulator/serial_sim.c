@@ -0,0 +1,67 @@
+#include	"serial.h"
+
+/** \file
+	\brief Serial stand-in for the simulator
+
+	Output goes to stderr, so stdout is free for the step trace. Input isn't
+	read from here, simulator.c feeds G-code to the parser directly.
+*/
+
+#include	<stdio.h>
+
+/// suppress output, set by simulator.c
+uint8_t	serial_quiet = 0;
+
+/// initialise serial subsystem
+void serial_init() {
+}
+
+/// nothing is ever received
+uint8_t serial_rxchars() {
+	return 0;
+}
+
+/// nothing is ever received
+uint8_t serial_rxlines() {
+	return 0;
+}
+
+/// the simulator reads input directly, report the default buffer as free
+uint8_t serial_rxfree() {
+	return 63;
+}
+
+/// nothing is ever received
+uint8_t serial_popchar() {
+	return 0;
+}
+
+/// send one character
+void serial_writechar(uint8_t data) {
+	if ( ! serial_quiet)
+		fputc(data, stderr);
+}
+
+/// send a block of data
+void serial_writeblock(void *data, int datalen) {
+	int i;
+
+	for (i = 0; i < datalen; i++)
+		serial_writechar(((uint8_t *) data)[i]);
+}
+
+/// send a string
+void serial_writestr(uint8_t *data) {
+	while (*data)
+		serial_writechar(*data++);
+}
+
+/// send a block of data from flash
+void serial_writeblock_P(PGM_P data, int datalen) {
+	serial_writeblock((void *) data, datalen);
+}
+
+/// send a string from flash
+void serial_writestr_P(PGM_P data) {
+	serial_writestr((uint8_t *) data);
+}
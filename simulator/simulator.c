@@ -0,0 +1,527 @@
+#include	"simulator.h"
+
+/** \file
+	\brief Simulator - run the motion code on the build host
+
+	Build with "make sim", using config.h like the firmware does. The config
+	has to be of the kind including config_macros.h, like config.ramps-v1.3.h,
+	config.h.dist lacks the macros the motion code needs. Then run
+
+		simulator/teacup_sim [-q] [-s] [-p] [-o tracefile] [file.gcode]
+
+	G-code is read from the file or from stdin and handled by the very same
+	gcode_parse.c, gcode_process.c, dda.c, dda_queue.c and timer.c as on the
+	board. Each step is written to the trace (stdout by default) as one line of
+
+		<time> <axis> <direction> <position>
+
+	time being in CPU clock ticks since start, direction + or -, position the
+	axis position in steps after this step. Serial output of the firmware and
+	a summary go to stderr. -q suppresses both the trace and serial output,
+	for benchmarking.
+
+	The summary includes the host time spent in dda_create(), dda_lookahead()
+	and dda_step(), the latter being the step interrupt less the interrupt
+	entry and exit. dda_step() is too short for the system clock, so it's
+	timed in ticks of the time stamp counter on x86 hosts, in nanoseconds on
+	others. These are only good for comparing code versions on the same host,
+	as an AVR is slower by very different factors for different operations,
+	like 32 bit divisions. simulator/ramp_moves.py writes the G-code used to
+	compare RAMP_TABLE on and off. Time spent in delays is simulated time, it
+	doesn't count here. The number of dda_step() calls is the number of step
+	interrupts.
+
+	Simulated time passes only where the firmware waits: in delays, in cli()
+	and memory barriers from outside interrupts, which is how busy loops poll,
+	and while the simulator waits for the movebuffer to drain. Everything
+	else, interrupts included, takes no time.
+
+	-s is a stress test for code shared with interrupts, like the lock free
+	movebuffer. Each memory barrier outside interrupts takes a random time
+	of up to STRESS_TIME instead, so interrupts strike between nearly all
+	loads and stores around them. Lines of G-code arrive a random time of up
+	to STRESS_LINE_TIME apart, so the movebuffer runs empty now and then.
+	Positions at the end have to be the same as without -s, and there must
+	be no stalls, moves waiting in the movebuffer with the step interrupt
+	stopped.
+
+	-p benchmarks the G-code parser: the file is fed to gcode_parse_char()
+	over and over for a second, without executing the commands, and the
+	throughput in bytes per second of host time is reported. Only useful for
+	comparing parser versions on the same host.
+
+	Timer 1 counts CPU clock ticks. A comparator interrupt fires when the
+	counter matches while the interrupt is enabled. A match while global
+	interrupts are disabled is delivered as soon as simulated time passes with
+	interrupts enabled again. Interrupt flags aren't simulated beyond that, a
+	match while the comparator's own interrupt is disabled is dropped, as if
+	its flag was cleared before enabling the interrupt.
+*/
+
+#include	<stdio.h>
+#include	<stdlib.h>
+#include	<time.h>
+#include	<unistd.h>
+
+#include	<avr/interrupt.h>
+
+#include	"config.h"
+#include	"arduino.h"
+#include	"dda.h"
+#include	"dda_queue.h"
+#include	"gcode_parse.h"
+#include	"timer.h"
+#include	"clock.h"
+#include	"delay.h"
+#include	"serial.h"
+#ifdef	ARC_SUPPORT
+	#include	"arc.h"
+#endif
+
+#ifndef	STEPS_TO_UM
+	#error The simulator needs a config.h which includes config_macros.h, like config.ramps-v1.3.h.
+#endif
+#ifdef	LOOKAHEAD
+	#include	"dda_lookahead.h"
+#endif
+#ifdef	BINARY_GCODE
+	#include	"gcode_binary.h"
+#endif
+
+/*
+	I/O registers
+*/
+#define	SIM_REG8(name)	volatile uint8_t name;
+#define	SIM_REG16(name)	volatile uint16_t name;
+#include	"registers.h"
+#undef	SIM_REG8
+#undef	SIM_REG16
+
+/// simulated time a cli() from outside interrupts takes [CPU clock ticks]
+#define	CLI_TIME	16
+
+/// longest time a memory barrier takes with -s [CPU clock ticks]
+#define	STRESS_TIME	4096
+
+/// longest time between lines of G-code with -s [CPU clock ticks]
+#define	STRESS_LINE_TIME	(F_CPU / 4)
+
+/// simulated time since start [CPU clock ticks]
+static uint64_t	sim_time;
+
+/// comparator matches waiting for interrupts to be enabled, as TIMSK1 bits
+static uint8_t	pending;
+
+/// stress test, see -s
+static uint8_t	stress;
+
+/// moves found waiting with the step interrupt stopped, see -s
+static uint32_t	stalls;
+
+void TIMER1_COMPA_vect(void);
+void TIMER1_COMPB_vect(void);
+#ifdef	STEP_PULSE_WIDTH
+void TIMER1_COMPC_vect(void);
+#endif
+
+/// timer 1 comparators, in order of interrupt priority
+static const struct {
+	volatile uint16_t	*ocr;				///< output compare register
+	uint8_t						enable;			///< interrupt enable bit in TIMSK1
+	void							(*vector)(void);	///< interrupt handler
+} comparators[] = {
+	{ &OCR1A, OCIE1A, TIMER1_COMPA_vect },
+	{ &OCR1B, OCIE1B, TIMER1_COMPB_vect },
+	#ifdef	STEP_PULSE_WIDTH
+	{ &OCR1C, OCIE1C, TIMER1_COMPC_vect },
+	#endif
+};
+
+#define	COMPARATORS	(sizeof(comparators) / sizeof(comparators[0]))
+
+/// run an interrupt handler, if its interrupt is still enabled
+static void interrupt(uint8_t i) {
+	pending &= ~MASK(comparators[i].enable);
+	if (TIMSK1 & MASK(comparators[i].enable)) {
+		SREG &= ~MASK(SREG_I);
+		comparators[i].vector();
+		SREG |= MASK(SREG_I);
+	}
+}
+
+/*! let simulated time pass
+	\param cycles CPU clock ticks to pass
+
+	Called from busy loops of the firmware. Interrupts coming due meanwhile
+	are run, if interrupts are enabled.
+*/
+void sim_delay(uint32_t cycles) {
+	uint64_t end = sim_time + cycles;
+	uint32_t d, next;
+	uint8_t i;
+
+	for (;;) {
+		// deliver matches, highest priority first
+		if (pending && (SREG & MASK(SREG_I))) {
+			for (i = 0; (pending & MASK(comparators[i].enable)) == 0; i++);
+			interrupt(i);
+			continue;
+		}
+
+		// interrupt handlers may wait, too
+		if (sim_time >= end)
+			break;
+
+		// advance to the next comparator match
+		next = end - sim_time;
+		for (i = 0; i < COMPARATORS; i++) {
+			if ((TIMSK1 & MASK(comparators[i].enable)) == 0)
+				continue;
+			d = (uint16_t) (*comparators[i].ocr - TCNT1);
+			if (d == 0)
+				d = 65536;
+			if (d < next)
+				next = d;
+		}
+		sim_time += next;
+		TCNT1 = sim_time & 0xFFFF;
+
+		// several comparators can match at the same time
+		for (i = 0; i < COMPARATORS; i++)
+			if ((TIMSK1 & MASK(comparators[i].enable)) && *comparators[i].ocr == TCNT1)
+				pending |= MASK(comparators[i].enable);
+	}
+}
+
+/// disable interrupts, giving those due a chance to run before
+void sim_cli() {
+	if (SREG & MASK(SREG_I))
+		sim_delay(CLI_TIME);
+	SREG &= ~MASK(SREG_I);
+}
+
+/// memory barrier, a point where interrupts may strike from outside interrupts
+void sim_barrier() {
+	if (SREG & MASK(SREG_I))
+		sim_delay(stress ? (uint32_t) rand() % STRESS_TIME : CLI_TIME);
+}
+
+/*
+	step trace
+*/
+
+#define	SIM_PORT(IO)	_SIM_PORT(IO)
+#define	_SIM_PORT(IO)	(&IO ## _WPORT)
+#define	SIM_MASK(IO)	_SIM_MASK(IO)
+#define	_SIM_MASK(IO)	MASK(IO ## _PIN)
+
+#ifdef	X_INVERT_DIR
+	#define	X_DIR_INVERTED	1
+#else
+	#define	X_DIR_INVERTED	0
+#endif
+#ifdef	Y_INVERT_DIR
+	#define	Y_DIR_INVERTED	1
+#else
+	#define	Y_DIR_INVERTED	0
+#endif
+#ifdef	Z_INVERT_DIR
+	#define	Z_DIR_INVERTED	1
+#else
+	#define	Z_DIR_INVERTED	0
+#endif
+#ifdef	E_INVERT_DIR
+	#define	E_DIR_INVERTED	1
+#else
+	#define	E_DIR_INVERTED	0
+#endif
+
+#define	AXIS(name, step, dir) \
+	{ #name[0], SIM_PORT(step), SIM_MASK(step), SIM_PORT(dir), SIM_MASK(dir), name ## _DIR_INVERTED, 0, 0, 0 }
+
+/// an axis as seen on its step and direction pins
+typedef struct {
+	char							name;
+	volatile uint8_t	*step_port;
+	uint8_t						step_mask;
+	volatile uint8_t	*dir_port;
+	uint8_t						dir_mask;
+	uint8_t						dir_inverted;
+
+	uint8_t						step_level;	///< step pin level at the last look
+	int32_t						position;		///< position [steps]
+	uint32_t					steps;			///< steps done in either direction
+} AXIS;
+
+static AXIS axes[] = {
+	AXIS(X, X_STEP_PIN, X_DIR_PIN),
+	AXIS(Y, Y_STEP_PIN, Y_DIR_PIN),
+	#if defined Z_STEP_PIN && defined Z_DIR_PIN
+	AXIS(Z, Z_STEP_PIN, Z_DIR_PIN),
+	#endif
+	#if defined E_STEP_PIN && defined E_DIR_PIN
+	AXIS(E, E_STEP_PIN, E_DIR_PIN),
+	#endif
+};
+
+#define	AXES	(sizeof(axes) / sizeof(axes[0]))
+
+/// where the step trace goes, NULL for none
+static FILE	*trace;
+
+/// a pin was written, record rising edges of step pins
+void sim_pins_written() {
+	uint8_t i, level, dir;
+	AXIS *a;
+
+	for (i = 0; i < AXES; i++) {
+		a = &axes[i];
+		level = (*a->step_port & a->step_mask) ? 1 : 0;
+		if (level && ! a->step_level) {
+			dir = ((*a->dir_port & a->dir_mask) ? 1 : 0) ^ a->dir_inverted;
+			a->position += dir ? 1 : -1;
+			a->steps++;
+			if (trace)
+				fprintf(trace, "%llu %c %c %ld\n", (unsigned long long) sim_time,
+				        a->name, dir ? '+' : '-', (long) a->position);
+		}
+		a->step_level = level;
+	}
+}
+
+/*
+	planner timing, dda_create(), dda_lookahead() and dda_step() are wrapped
+	at link time
+*/
+
+/// host time spent in a function
+typedef struct {
+	uint32_t	calls;
+	uint64_t	ns;
+} TIMING;
+
+static TIMING	create_timing, lookahead_timing;
+
+/// dda_step() calls and host ticks spent in them, see host_ticks()
+static uint32_t	step_calls;
+static uint64_t	step_ticks;
+
+/// time it takes to read the host clock, subtracted from dda_step() timing
+static uint64_t	clock_ticks;
+
+static uint64_t host_ns(void) {
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (uint64_t) t.tv_sec * 1000000000 + t.tv_nsec;
+}
+
+void __real_dda_create(DDA *dda, TARGET *target);
+
+void __wrap_dda_create(DDA *dda, TARGET *target) {
+	uint64_t start = host_ns();
+
+	__real_dda_create(dda, target);
+	create_timing.ns += host_ns() - start;
+	create_timing.calls++;
+}
+
+/// host clock for short times, the time stamp counter where there is one
+static inline uint64_t host_ticks(void) {
+	#if defined __x86_64__ || defined __i386__
+		return __builtin_ia32_rdtsc();
+	#else
+		return host_ns();
+	#endif
+}
+
+void __real_dda_step(DDA *dda);
+
+void __wrap_dda_step(DDA *dda) {
+	uint64_t start = host_ticks();
+
+	__real_dda_step(dda);
+	step_ticks += host_ticks() - start;
+	step_calls++;
+}
+
+/// measure how long reading the host clock takes, as dda_step() is short
+static void calibrate_clock(void) {
+	uint64_t start, min = UINT64_MAX;
+	uint32_t i;
+
+	for (i = 0; i < 100000; i++) {
+		start = host_ticks();
+		start = host_ticks() - start;
+		if (start < min)
+			min = start;
+	}
+	clock_ticks = min;
+}
+
+#ifdef	LOOKAHEAD
+void __real_dda_lookahead(void);
+
+void __wrap_dda_lookahead(void) {
+	uint64_t start = host_ns();
+
+	__real_dda_lookahead();
+	lookahead_timing.ns += host_ns() - start;
+	lookahead_timing.calls++;
+}
+#endif
+
+/// -p, parse without executing
+static uint8_t	parse_only;
+
+void __real_process_gcode_command(void);
+
+void __wrap_process_gcode_command(void) {
+	if ( ! parse_only)
+		__real_process_gcode_command();
+}
+
+/// feed the input to the parser repeatedly, report bytes per second
+static void parse_benchmark(FILE *in) {
+	static uint8_t buffer[1 << 20];
+	size_t length, i;
+	uint64_t start, ns, bytes = 0;
+
+	length = fread(buffer, 1, sizeof(buffer), in);
+	if (length == 0)
+		return;
+	start = host_ns();
+	do {
+		for (i = 0; i < length; i++)
+			gcode_parse_char(buffer[i]);
+		bytes += length;
+		ns = host_ns() - start;
+	} while (ns < 1000000000);
+	fprintf(stderr, "# parser: %lu bytes, %.0f bytes/s\n", (unsigned long) length, bytes * 1e9 / ns);
+}
+
+static void print_timing(const char *name, TIMING *t) {
+	if (t->calls == 0)
+		return;
+	fprintf(stderr, "# %s: %u calls, %.3f us each, %.0f calls/s\n", name, t->calls,
+	        t->ns / 1000.0 / t->calls, t->calls * 1e9 / t->ns);
+}
+
+/*
+	main
+*/
+
+extern uint8_t	serial_quiet;
+
+int main(int argc, char **argv) {
+	FILE *in = stdin;
+	uint8_t quiet = 0;
+	uint8_t i;
+	int c;
+
+	trace = stdout;
+	while ((c = getopt(argc, argv, "qspo:")) != -1) {
+		switch (c) {
+			case 'q':
+				quiet = 1;
+				break;
+			case 's':
+				stress = 1;
+				break;
+			case 'p':
+				parse_only = 1;
+				break;
+			case 'o':
+				trace = fopen(optarg, "w");
+				if (trace == NULL) {
+					perror(optarg);
+					return 1;
+				}
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-q] [-s] [-p] [-o tracefile] [file.gcode]\n", argv[0]);
+				return 1;
+		}
+	}
+	if (optind < argc) {
+		in = fopen(argv[optind], "r");
+		if (in == NULL) {
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+	if (quiet || parse_only) {
+		trace = NULL;
+		serial_quiet = 1;
+	}
+	if (parse_only) {
+		parse_benchmark(in);
+		return 0;
+	}
+
+	if (trace)
+		fprintf(trace, "# time [1/%lu s], axis, direction, position [steps]\n", (unsigned long) F_CPU);
+
+	calibrate_clock();
+
+	// same as init() in mendel.c, as far as there's something to simulate
+	serial_init();
+	timer_init();
+	dda_init();
+	sei();
+	serial_writestr_P(PSTR("start\nok\n"));
+
+	// same as the main loop in mendel.c, reading from the file instead of serial
+	for (;;) {
+		#ifdef	ARC_SUPPORT
+		if (arc_busy()) {
+			if (queue_full())
+				sim_delay(WAITING_DELAY US);
+			else
+				arc_step();
+		}
+		else
+		#endif
+		{
+			c = fgetc(in);
+			if (c == EOF)
+				break;
+			#ifdef	BINARY_GCODE
+			if (binary_mode)
+				binary_parse_char(c);
+			else
+			#endif
+			gcode_parse_char(c);
+			if (stress && c == '\n') {
+				sim_delay((uint32_t) rand() % STRESS_LINE_TIME);
+				if (queue_empty() == 0 && (TIMSK1 & MASK(OCIE1A)) == 0)
+					stalls++;
+			}
+		}
+
+		#ifdef	STEP_RING_SIZE
+			dda_fill_ring();
+		#endif
+
+		ifclock(clock_flag_10ms) {
+			clock_10ms();
+		}
+	}
+
+	// execute what's left in the movebuffer
+	queue_wait();
+
+	fprintf(stderr, "\n# simulated time: %.6f s\n", (double) sim_time / F_CPU);
+	for (i = 0; i < AXES; i++)
+		fprintf(stderr, "# %c: %u steps, position %ld\n", axes[i].name,
+		        axes[i].steps, (long) axes[i].position);
+	if (stress)
+		fprintf(stderr, "# stress test: %u stalls\n", stalls);
+	print_timing("dda_create", &create_timing);
+	print_timing("dda_lookahead", &lookahead_timing);
+	if (step_calls)
+		fprintf(stderr, "# dda_step: %u calls, %.1f host ticks each\n", step_calls,
+		        (double) step_ticks / step_calls - clock_ticks);
+
+	return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef	_SIMULATOR_H
+#define	_SIMULATOR_H
+
+#include	<stdint.h>
+
+/*
+	Simulator - run the firmware on the build host
+
+	Everything here is only for the simulator build, see simulator.c.
+*/
+
+// let simulated time pass, firing interrupts as they come due
+void sim_delay(uint32_t cycles);
+
+// disable interrupts; calls from outside interrupts take a little time
+void sim_cli(void);
+
+// memory barrier, interrupts may come due here
+void sim_barrier(void);
+
+// a pin was written, look for step pulses
+void sim_pins_written(void);
+
+#endif	/* _SIMULATOR_H */
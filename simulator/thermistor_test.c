@@ -0,0 +1,78 @@
+/** \file
+	\brief Host test of the thermistor lookup in temp.c
+
+	Build and run with "make sim-test", using config.h like the simulator.
+
+	Each reading from 0 to 1023, with all the fractions ADC_EXTRA_BITS
+	adds, is fed to temp_sensor_tick() for each thermistor and the result is
+	compared against the interpolation temp.c did before the slope column,
+	y = ((x - x0) * y1 + (x1 - x) * y0) / (x1 - x0), on the fine reading.
+	Readings outside the table have to read as its end entries. Prints the
+	number of readings off by more than a quarter degree, the precision of
+	the table, and exits with 1 if there are any.
+*/
+
+#include	<stdio.h>
+#include	<stdlib.h>
+
+// temp_sensors and the table are static, so take temp.c in
+#include	"temp.c"
+
+/// the reading temp_sensor_tick() gets, 10 + ADC_EXTRA_BITS bits
+static uint16_t reading;
+
+uint16_t analog_read_fine(uint8_t channel) {
+	return reading;
+}
+
+void heater_tick(heater_t h, temp_sensor_t t, uint16_t current_temp, uint16_t target_temp) {
+}
+
+/// the old interpolation between the two entries around reading r, extended
+/// to the fractions of ADC_EXTRA_BITS [14.2 fixed point]
+static uint16_t reference(uint8_t table_num, uint32_t r) {
+	uint8_t		j;
+	uint32_t	x0, y0, x1, y1;
+
+	if (r < ((uint32_t) temptable[table_num][0][0] << ADC_EXTRA_BITS))
+		return temptable[table_num][0][1];
+	for (j = 1; j < NUMTEMPS; j++) {
+		if (((uint32_t) temptable[table_num][j][0] << ADC_EXTRA_BITS) > r) {
+			x0 = (uint32_t) temptable[table_num][j - 1][0] << ADC_EXTRA_BITS;
+			y0 = temptable[table_num][j - 1][1];
+			x1 = (uint32_t) temptable[table_num][j][0] << ADC_EXTRA_BITS;
+			y1 = temptable[table_num][j][1];
+			return ((r - x0) * y1 + (x1 - r) * y0) / (x1 - x0);
+		}
+	}
+	return temptable[table_num][NUMTEMPS - 1][1];
+}
+
+int main(void) {
+	temp_sensor_t	i;
+	uint32_t			r, tests = 0, bad = 0;
+	int						diff, max = 0;
+
+	for (i = 0; i < NUM_TEMP_SENSORS; i++) {
+		if (temp_sensors[i].temp_type != TT_THERMISTOR)
+			continue;
+		for (r = 0; r < (1024UL << ADC_EXTRA_BITS); r++) {
+			reading = r;
+			temp_sensor_tick();
+			diff = abs((int) temp_get(i) - (int) reference(temp_sensors[i].additional, r));
+			if (diff > max)
+				max = diff;
+			tests++;
+			if (diff > 1) {
+				if (bad++ < 10)
+					printf("sensor %d reading %.3f: %.2f C, expected %.2f C\n", i,
+						(double) r / (1 << ADC_EXTRA_BITS), temp_get(i) / 4.,
+						reference(temp_sensors[i].additional, r) / 4.);
+			}
+		}
+	}
+
+	printf("thermistor lookup: %u readings, %u off by more than 0.25 C, largest difference %.2f C\n",
+		tests, bad, max / 4.);
+	return bad ? 1 : 0;
+}
@@ -0,0 +1,12 @@
+/** \file
+	\brief Simulator stand-in for <util/atomic.h>
+
+	Nothing from there is used, but like avr-libc's it brings cli() and sei().
+*/
+
+#ifndef	_SIM_UTIL_ATOMIC_H
+#define	_SIM_UTIL_ATOMIC_H
+
+#include	<avr/interrupt.h>
+
+#endif	/* _SIM_UTIL_ATOMIC_H */
@@ -0,0 +1,24 @@
+/** \file
+	\brief Simulator stand-in for <util/crc16.h>
+*/
+
+#ifndef	_SIM_UTIL_CRC16_H
+#define	_SIM_UTIL_CRC16_H
+
+#include	<stdint.h>
+
+/// CRC-16 as in avr-libc, polynomial 0xA001
+static inline uint16_t _crc16_update(uint16_t crc, uint8_t a) {
+	uint8_t i;
+
+	crc ^= a;
+	for (i = 0; i < 8; i++) {
+		if (crc & 1)
+			crc = (crc >> 1) ^ 0xA001;
+		else
+			crc = (crc >> 1);
+	}
+	return crc;
+}
+
+#endif	/* _SIM_UTIL_CRC16_H */
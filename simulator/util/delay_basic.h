@@ -0,0 +1,24 @@
+/** \file
+	\brief Simulator stand-in for <util/delay_basic.h>
+
+	Busy loops advance simulated time instead of wasting real time.
+*/
+
+#ifndef	_SIM_UTIL_DELAY_BASIC_H
+#define	_SIM_UTIL_DELAY_BASIC_H
+
+#include	<stdint.h>
+
+#include	"simulator.h"
+
+/// 3 CPU cycles per count, 0 means 256
+static inline void _delay_loop_1(uint8_t count) {
+	sim_delay(3 * (count ? count : 256UL));
+}
+
+/// 4 CPU cycles per count, 0 means 65536
+static inline void _delay_loop_2(uint16_t count) {
+	sim_delay(4 * (count ? count : 65536UL));
+}
+
+#endif	/* _SIM_UTIL_DELAY_BASIC_H */
@@ -27,6 +27,12 @@
 #ifdef	TEMP_THERMISTOR
 #include	"analog.h"
 #include	"ThermistorTable.h"
+
+/// stops the build with a negative array size if the table lacks the slope
+/// column, tables of older versions have to be created anew with
+/// createTemperatureLookup.py
+typedef char thermistor_table_needs_3_columns_run_createTemperatureLookup_py[
+	(sizeof(temptable[0][0]) == 3 * sizeof(uint16_t)) ? 1 : -1];
 #endif
 
 #ifdef	TEMP_AD595
@@ -166,59 +172,51 @@ void temp_sensor_tick() {
 				#ifdef	TEMP_THERMISTOR
 				case TT_THERMISTOR:
 					do {
-						uint8_t j, table_num;
-						//Read current temperature
-						temp = analog_read(temp_sensors[i].temp_pin);
+						uint8_t lo, mid, j, table_num;
+						//Read current temperature, with ADC_EXTRA_BITS more than the table
+						temp = analog_read_fine(temp_sensors[i].temp_pin);
 						// for thermistors the thermistor table number is in the additional field
 						table_num = temp_sensors[i].additional;
 
 						//Calculate real temperature based on lookup table
-						for (j = 1; j < NUMTEMPS; j++) {
-							if (pgm_read_word(&(temptable[table_num][j][0])) > temp) {
-								// Thermistor table is already in 14.2 fixed point
-								#ifndef	EXTRUDER
-								if (DEBUG_PID && (debug_flags & DEBUG_PID))
-									sersendf_P(PSTR("pin:%d Raw ADC:%d table entry: %d"),temp_sensors[i].temp_pin,temp,j);
-								#endif
-								// Linear interpolating temperature value
-								// y = ((x - x₀)y₁ + (x₁-x)y₀ ) / (x₁ - x₀)
-								// y = temp
-								// x = ADC reading
-								// x₀= temptable[j-1][0]
-								// x₁= temptable[j][0]
-								// y₀= temptable[j-1][1]
-								// y₁= temptable[j][1]
-								// y =
-								// Wikipedia's example linear interpolation formula.
-								temp = (
-								//     ((x - x₀)y₁
-									((uint32_t)temp - pgm_read_word(&(temptable[table_num][j-1][0]))) * pgm_read_word(&(temptable[table_num][j][1]))
-								//                 +
-									+
-								//                   (x₁-x)
-									(pgm_read_word(&(temptable[table_num][j][0])) - (uint32_t)temp)
-								//                         y₀ )
-									* pgm_read_word(&(temptable[table_num][j-1][1])))
-								//                              /
-									/
-								//                                (x₁ - x₀)
-									(pgm_read_word(&(temptable[table_num][j][0])) - pgm_read_word(&(temptable[table_num][j-1][0])));
-								#ifndef	EXTRUDER
-								if (DEBUG_PID && (debug_flags & DEBUG_PID))
-									sersendf_P(PSTR(" temp:%d.%d"),temp/4,(temp%4)*25);
-								#endif
-								break;
-							}
+						// binary search for the first entry above the reading, j = NUMTEMPS if none
+						lo = 0;
+						j = NUMTEMPS;
+						while (lo < j) {
+							mid = (lo + j) >> 1;
+							if (pgm_read_word(&(temptable[table_num][mid][0])) > (temp >> ADC_EXTRA_BITS))
+								j = mid;
+							else
+								lo = mid + 1;
 						}
 						#ifndef	EXTRUDER
 						if (DEBUG_PID && (debug_flags & DEBUG_PID))
-							sersendf_P(PSTR(" Sensor:%d\n"),i);
+							sersendf_P(PSTR("pin:%d Raw ADC:%d table entry: %d"),temp_sensors[i].temp_pin,temp,j);
 						#endif
 
-
-						//Clamp for overflows
-						if (j == NUMTEMPS)
-							temp = temptable[table_num][NUMTEMPS-1][1];
+						//Clamp for readings outside the table
+						if (j == 0)
+							temp = pgm_read_word(&(temptable[table_num][0][1]));
+						else if (j == NUMTEMPS)
+							temp = pgm_read_word(&(temptable[table_num][NUMTEMPS-1][1]));
+						else {
+							// Thermistor table is already in 14.2 fixed point
+							// Linear interpolating temperature value, from the upper end of the
+							// segment, with the slope precalculated by createTemperatureLookup.py
+							// y = y₁ + (x₁ - x) * slope / 256
+							// y = temp
+							// x = ADC reading, taking fractions from ADC_EXTRA_BITS into account
+							// x₁= temptable[j][0]
+							// y₁= temptable[j][1]
+							// slope = (y₀ - y₁) * 256 / (x₁ - x₀) = temptable[j][2]
+							temp = pgm_read_word(&(temptable[table_num][j][1])) +
+								(((uint32_t)((pgm_read_word(&(temptable[table_num][j][0])) << ADC_EXTRA_BITS) - temp)
+								* pgm_read_word(&(temptable[table_num][j][2]))) >> (8 + ADC_EXTRA_BITS));
+						}
+						#ifndef	EXTRUDER
+						if (DEBUG_PID && (debug_flags & DEBUG_PID))
+							sersendf_P(PSTR(" temp:%d.%d Sensor:%d\n"),temp/4,(temp%4)*25,i);
+						#endif
 
 						temp_sensors_runtime[i].next_read_time = 0;
 					} while (0);
@@ -227,11 +225,11 @@ void temp_sensor_tick() {
 
 				#ifdef	TEMP_AD595
 				case TT_AD595:
-					temp = analog_read(temp_sensors[i].temp_pin);
+					temp = analog_read_fine(temp_sensors[i].temp_pin);
 
 					// convert
 					// >>8 instead of >>10 because internal temp is stored as 14.2 fixed point
-					temp = (temp * 500L) >> 8;
+					temp = (temp * 500L) >> (8 + ADC_EXTRA_BITS);
 
 					temp_sensors_runtime[i].next_read_time = 0;
 
@@ -326,6 +324,15 @@ uint16_t temp_get(temp_sensor_t index) {
 	return temp_sensors_runtime[index].last_read_temp;
 }
 
+/// report whether a sensor has a heater attached
+/// \param index sensor to check
+uint8_t temp_has_heater(temp_sensor_t index) {
+	if (index >= NUM_TEMP_SENSORS)
+		return 0;
+
+	return (temp_sensors[index].heater < NUM_HEATERS) ? 255 : 0;
+}
+
 uint8_t temp_all_zero() {
 	uint8_t i;
 	for (i = 0; i < NUM_TEMP_SENSORS; i++) {
@@ -41,6 +41,8 @@ uint8_t	temp_achieved(void);
 void temp_set(temp_sensor_t index, uint16_t temperature);
 uint16_t temp_get(temp_sensor_t index);
 
+uint8_t temp_has_heater(temp_sensor_t index);
+
 uint8_t temp_all_zero(void);
 
 void temp_print(temp_sensor_t index);
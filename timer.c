@@ -18,8 +18,12 @@
 #ifdef	HOST
 #include	"dda_queue.h"
 #endif
+#ifdef	STEP_PULSE_WIDTH
+#include	"pinio.h"
+#endif
 
 #include	"memory_barrier.h"
+#include	"profile.h"
 
 /// how often we overflow and update our clock; with F_CPU=16MHz, max is < 4.096ms (TICK_TIME = 65535)
 #define		TICK_TIME			2 MS
@@ -76,6 +80,8 @@ ISR(TIMER1_COMPB_vect) {
 ISR(TIMER1_COMPA_vect) {
 	// Check if this is a real step, or just a next_step_time "overflow"
 	if (next_step_time < 65536) {
+		PROFILE_START(ISR);
+
 		// step!
 		#ifdef DEBUG_LED_PIN
 			WRITE(DEBUG_LED_PIN, 1);
@@ -105,6 +111,8 @@ ISR(TIMER1_COMPA_vect) {
 		if (timer1_compa_deferred_enable) {
 			TIMSK1 |= MASK(OCIE1A);
 		}
+
+		PROFILE_END(ISR);
 		return;
 	}
 
@@ -119,6 +127,14 @@ ISR(TIMER1_COMPA_vect) {
 	}
 	// leave OCR1A as it was
 }
+
+#ifdef	STEP_PULSE_WIDTH
+/// comparator C ends the step pulses started in the step interrupt, see unstep_later()
+ISR(TIMER1_COMPC_vect) {
+	unstep();
+	TIMSK1 &= ~MASK(OCIE1C);
+}
+#endif
 #endif /* ifdef HOST */
 
 /// initialise timer and enable system clock interrupt.
@@ -4,6 +4,9 @@
 #include	<stdint.h>
 #include	<avr/io.h>
 
+#include	"config.h"
+#include	"arduino.h"
+
 // time-related constants
 #define	US	* (F_CPU / 1000000)
 #define	MS	* (F_CPU / 1000)
@@ -30,4 +33,13 @@ void setTimer(uint32_t delay);
 
 void timer_stop(void);
 
+#ifdef STEP_PULSE_WIDTH
+	#ifndef OCR1C
+		#error STEP_PULSE_WIDTH needs timer 1 comparator C, which this chip does not have.
+	#endif
+
+/// end the step pulses just started after STEP_PULSE_WIDTH, using timer 1 comparator C
+#define	unstep_later()	do { OCR1C = TCNT1 + (STEP_PULSE_WIDTH US); TIFR1 = MASK(OCF1C); TIMSK1 |= MASK(OCIE1C); } while (0)
+#endif
+
 #endif	/* _TIMER_H */